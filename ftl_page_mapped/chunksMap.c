@@ -0,0 +1,743 @@
+#include "chunksMap.h"
+#include "ftl_metadata.h"
+#include "ftl_parameters.h"
+#include "dram_layout.h"
+#include "flash.h" // RETURN_ON_ISSUE, waitBusyBank
+
+/* Accessors of the chunks map table, which maps every chunk of a data lpn to its logical chunk address.
+ * Without OPTION_DEMAND_PAGED_MAP the whole table is resident in DRAM.
+ * With OPTION_DEMAND_PAGED_MAP the table is split in translation pages of LPNS_PER_MAP_PAGE lpns each,
+ * stored in the map blocks of every bank. Only NUM_CACHED_MAP_PAGES translation pages are cached in DRAM
+ * and they are replaced in LRU order, while the map directory in DRAM records where each one lives in flash.
+ * When a dirty page is evicted, it is written back together with the oldest dirty pages, up to
+ * mapWriteBackBatch pages, striped over the banks.
+ * Map blocks are written as a log. Every bank keeps one erased map block: when the active map block is full
+ * the erased one becomes active, the valid translation pages of the map block with fewest valid pages are
+ * copied back into it, and that block is erased. A bank is never chosen for write-back if its map blocks
+ * hold so many valid pages that this cleaning could not free a block.
+ * With OPTION_COMPRESSED_MAP every lpn has a single page entry. A page whose chunks are stored in order at
+ * consecutive chunk addresses, as done by writeCompletePage and by GC, is mapped by its first chunk address
+ * tagged with ContiguousPageFlag. Any other page gets a chunk map slot with one entry per chunk, and the page
+ * entry holds the slot index. A slot is released as soon as its chunks become contiguous or all invalid.
+ * When the free slots run low, chunksMapFragmentedLpn returns lpns that hold a slot, round robin, so that they are
+ * rewritten contiguously (consolidateFragmentedPages). */
+
+#if OPTION_DEMAND_PAGED_MAP && OPTION_COMPRESSED_MAP
+#error("OPTION_DEMAND_PAGED_MAP and OPTION_COMPRESSED_MAP cannot be enabled together")
+#endif
+
+#if OPTION_DEMAND_PAGED_MAP
+
+#define MapLoc(bank, mapBlk, page)      ((((bank) * MAP_BLK_PER_BANK) + (mapBlk)) * PAGES_PER_VBLK + (page))
+#define MapLocToBank(loc)               ((loc) / (MAP_BLK_PER_BANK * PAGES_PER_VBLK))
+#define MapLocToBlk(loc)                (((loc) / PAGES_PER_VBLK) % MAP_BLK_PER_BANK)
+#define MapLocToPage(loc)               ((loc) % PAGES_PER_VBLK)
+#define MaxValidMapPagesPerBank         ((MAP_BLK_PER_BANK - 1) * PAGES_PER_VBLK - 1)
+#define NO_MAP_SLOT                     0xFF
+
+#if NUM_CACHED_MAP_PAGES >= NO_MAP_SLOT
+#error("too many cached map pages")
+#endif
+
+static UINT8 mapPageSlot[NUM_MAP_PAGES];
+static UINT32 slotMapPage[NUM_CACHED_MAP_PAGES];
+static UINT32 slotLastUse[NUM_CACHED_MAP_PAGES];
+static UINT8 slotDirty[NUM_CACHED_MAP_PAGES];
+static UINT32 mapUseClock;
+
+static UINT16 mapBlkVbn[NUM_BANKS][MAP_BLK_PER_BANK];
+static UINT16 mapBlkValid[NUM_BANKS][MAP_BLK_PER_BANK];
+static UINT32 mapValidInBank[NUM_BANKS];
+static UINT32 mapActiveBlk[NUM_BANKS];
+static UINT32 mapFreeBlk[NUM_BANKS];
+static UINT32 mapNextPage[NUM_BANKS];
+static UINT32 mapNextBank;
+static UINT32 mapPendingBank; // bank still programming a translation page written back in idle time
+
+static void cleanMapBlk(const UINT32 bank)
+{
+    mapActiveBlk[bank] = mapFreeBlk[bank];
+    mapNextPage[bank] = 0;
+
+    UINT32 victim = INVALID;
+    UINT32 minValid = INVALID;
+    for (UINT32 blk=0; blk<MAP_BLK_PER_BANK; blk++)
+    {
+        if (blk != mapActiveBlk[bank] && mapBlkValid[bank][blk] < minValid)
+        {
+            victim = blk;
+            minValid = mapBlkValid[bank][blk];
+        }
+    }
+    uart_print("cleanMapBlk: bank "); uart_print_int(bank); uart_print(" victim map blk "); uart_print_int(victim);
+    uart_print(" valid pages "); uart_print_int(minValid); uart_print("\r\n");
+
+    UINT32 victimVbn = mapBlkVbn[bank][victim];
+    UINT32 activeVbn = mapBlkVbn[bank][mapActiveBlk[bank]];
+    for (UINT32 mapPage=0; mapPage<NUM_MAP_PAGES && mapBlkValid[bank][victim] > 0; mapPage++)
+    {
+        UINT32 loc = read_dram_32(MapDir(mapPage));
+        if (loc != INVALID && MapLocToBank(loc) == bank && MapLocToBlk(loc) == victim)
+        {
+            nand_page_copyback(bank, victimVbn, MapLocToPage(loc), activeVbn, mapNextPage[bank]);
+            write_dram_32(MapDir(mapPage), MapLoc(bank, mapActiveBlk[bank], mapNextPage[bank]));
+            mapNextPage[bank]++;
+            mapBlkValid[bank][victim]--;
+            mapBlkValid[bank][mapActiveBlk[bank]]++;
+        }
+    }
+    nand_block_erase_sync(bank, victimVbn);
+    mapFreeBlk[bank] = victim;
+}
+
+static UINT32 chooseMapBank()
+{
+    for (UINT32 i=0; i<NUM_BANKS; i++)
+    {
+        UINT32 bank = mapNextBank;
+        mapNextBank = (mapNextBank + 1) % NUM_BANKS;
+        if (mapValidInBank[bank] < MaxValidMapPagesPerBank)
+        {
+            return bank;
+        }
+    }
+    uart_print_level_1("ERROR in chooseMapBank: no space left in map blocks\r\n");
+    while(1);
+}
+
+// Returns the bank where the page is being programmed
+static UINT32 writeBackMapPage(const UINT32 slot)
+{
+    UINT32 mapPage = slotMapPage[slot];
+    UINT32 oldLoc = read_dram_32(MapDir(mapPage));
+    if (oldLoc != INVALID)
+    {
+        mapBlkValid[MapLocToBank(oldLoc)][MapLocToBlk(oldLoc)]--;
+        mapValidInBank[MapLocToBank(oldLoc)]--;
+    }
+
+    UINT32 bank = chooseMapBank();
+    UINT32 mapBlk = mapActiveBlk[bank];
+    UINT32 page = mapNextPage[bank];
+    uart_print("writeBackMapPage: map page "); uart_print_int(mapPage); uart_print(" to bank "); uart_print_int(bank);
+    uart_print(" map blk "); uart_print_int(mapBlk); uart_print(" page "); uart_print_int(page); uart_print("\r\n");
+    nand_page_program(bank, mapBlkVbn[bank][mapBlk], page, CachedMapPage(slot), RETURN_ON_ISSUE);
+    write_dram_32(MapDir(mapPage), MapLoc(bank, mapBlk, page));
+    mapBlkValid[bank][mapBlk]++;
+    mapValidInBank[bank]++;
+    mapNextPage[bank]++;
+    slotDirty[slot] = 0;
+
+    if (mapNextPage[bank] == PAGES_PER_VBLK)
+    {
+        cleanMapBlk(bank);
+    }
+    return bank;
+}
+
+static void writeBackDirtyMapPages(const UINT32 victimSlot)
+{
+    UINT32 banks = (UINT32)1 << writeBackMapPage(victimSlot);
+    for (UINT32 n=1; n<mapWriteBackBatch; n++)
+    {
+        UINT32 oldestSlot = INVALID;
+        UINT32 oldestUse = INVALID;
+        for (UINT32 slot=0; slot<NUM_CACHED_MAP_PAGES; slot++)
+        {
+            if (slotDirty[slot] && slotLastUse[slot] < oldestUse)
+            {
+                oldestSlot = slot;
+                oldestUse = slotLastUse[slot];
+            }
+        }
+        if (oldestSlot == INVALID)
+        {
+            break;
+        }
+        banks |= (UINT32)1 << writeBackMapPage(oldestSlot);
+    }
+    // The cached copies must not change until they have been transferred to flash
+    for (UINT32 bank=0; bank<NUM_BANKS; bank++)
+    {
+        if (banks & ((UINT32)1 << bank))
+        {
+            waitBusyBank(bank);
+        }
+    }
+}
+
+static UINT32 loadMapPage(const UINT32 mapPage)
+{
+    UINT32 slot = 0;
+    for (UINT32 i=1; i<NUM_CACHED_MAP_PAGES; i++)
+    {
+        if (slotLastUse[i] < slotLastUse[slot])
+        {
+            slot = i;
+        }
+    }
+    if (slotMapPage[slot] != INVALID)
+    {
+        if (slotDirty[slot])
+        {
+            writeBackDirtyMapPages(slot);
+        }
+        mapPageSlot[slotMapPage[slot]] = NO_MAP_SLOT;
+    }
+
+    UINT32 loc = read_dram_32(MapDir(mapPage));
+    uart_print("loadMapPage: map page "); uart_print_int(mapPage); uart_print(" in slot "); uart_print_int(slot); uart_print("\r\n");
+    if (loc == INVALID)
+    { // never written: all the chunks of its lpns are invalid
+        mem_set_dram(CachedMapPage(slot), INVALID, BYTES_PER_PAGE);
+    }
+    else
+    {
+        nand_page_read(MapLocToBank(loc), mapBlkVbn[MapLocToBank(loc)][MapLocToBlk(loc)], MapLocToPage(loc), CachedMapPage(slot));
+    }
+    slotMapPage[slot] = mapPage;
+    slotDirty[slot] = 0;
+    mapPageSlot[mapPage] = slot;
+    return slot;
+}
+
+static UINT32 mapEntriesAddr(const UINT32 lpn, const BOOL8 modify)
+{
+    if (mapPendingBank != INVALID)
+    { // the cached copy written back by tableWriteBackStep must not change before its transfer
+        waitBusyBank(mapPendingBank);
+        mapPendingBank = INVALID;
+    }
+    UINT32 mapPage = lpn / LPNS_PER_MAP_PAGE;
+    UINT32 slot = mapPageSlot[mapPage];
+    if (slot == NO_MAP_SLOT)
+    {
+        slot = loadMapPage(mapPage);
+    }
+    slotLastUse[slot] = ++mapUseClock;
+    if (modify)
+    {
+        slotDirty[slot] = 1;
+    }
+    return CachedMapPage(slot) + ((lpn % LPNS_PER_MAP_PAGE) * CHUNKS_PER_PAGE * sizeof(UINT32));
+}
+
+// Writes back the least recently used dirty translation page, without waiting for the program to complete
+static BOOL8 tableWriteBackStep()
+{
+    if (mapPendingBank != INVALID && isBankBusy(mapPendingBank))
+    {
+        return FALSE;
+    }
+    UINT32 oldestSlot = INVALID;
+    UINT32 oldestUse = INVALID;
+    for (UINT32 slot=0; slot<NUM_CACHED_MAP_PAGES; slot++)
+    {
+        if (slotDirty[slot] && slotLastUse[slot] < oldestUse)
+        {
+            oldestSlot = slot;
+            oldestUse = slotLastUse[slot];
+        }
+    }
+    if (oldestSlot == INVALID)
+    {
+        return FALSE;
+    }
+    mapPendingBank = writeBackMapPage(oldestSlot);
+    return TRUE;
+}
+
+void set_map_vbn(UINT32 const bank, UINT32 const mapBlk, UINT32 const vblock)
+{
+    mapBlkVbn[bank][mapBlk] = vblock;
+}
+
+static void tableInit()
+{
+    uart_print("chunksMapInit: map pages = "); uart_print_int(NUM_MAP_PAGES);
+    uart_print(", cached = "); uart_print_int(NUM_CACHED_MAP_PAGES); uart_print("\r\n");
+    if (NUM_MAP_PAGES > NUM_BANKS * MaxValidMapPagesPerBank)
+    {
+        uart_print_level_1("ERROR in chunksMapInit: map blocks are too small for the chunks map table\r\n");
+        while(1);
+    }
+    mem_set_dram(MAP_DIR_ADDR, INVALID, MAP_DIR_BYTES);
+    for (UINT32 mapPage=0; mapPage<NUM_MAP_PAGES; mapPage++)
+    {
+        mapPageSlot[mapPage] = NO_MAP_SLOT;
+    }
+    for (UINT32 slot=0; slot<NUM_CACHED_MAP_PAGES; slot++)
+    {
+        slotMapPage[slot] = INVALID;
+        slotLastUse[slot] = 0;
+        slotDirty[slot] = 0;
+    }
+    mapUseClock = 0;
+    for (UINT32 bank=0; bank<NUM_BANKS; bank++)
+    {
+        for (UINT32 mapBlk=0; mapBlk<MAP_BLK_PER_BANK; mapBlk++)
+        {
+            mapBlkValid[bank][mapBlk] = 0;
+        }
+        mapValidInBank[bank] = 0;
+        mapActiveBlk[bank] = 0;
+        mapFreeBlk[bank] = MAP_BLK_PER_BANK - 1;
+        mapNextPage[bank] = 0;
+    }
+    mapNextBank = 0;
+    mapPendingBank = INVALID;
+}
+
+#elif OPTION_COMPRESSED_MAP
+
+#define ContiguousPageFlag              (1 << 30) // chunk addresses never use this bit
+#define isChunkMapSlot(pageEntry)       ((pageEntry) != INVALID && ((pageEntry) & ContiguousPageFlag) == 0)
+
+static UINT32 freeSlotsHead; // free slots are chained through their first entry
+static UINT32 nFreeSlotsInList;
+static UINT32 nextUnusedSlot;
+static UINT32 fragmentedScanLpn;
+
+static UINT32 allocChunkMapSlot()
+{
+    UINT32 slot;
+    if (freeSlotsHead != INVALID)
+    {
+        slot = freeSlotsHead;
+        freeSlotsHead = read_dram_32(ChunkMapSlot(slot, 0));
+        nFreeSlotsInList--;
+    }
+    else if (nextUnusedSlot < NUM_CHUNK_MAP_SLOTS)
+    {
+        slot = nextUnusedSlot;
+        nextUnusedSlot++;
+    }
+    else
+    { // consolidateFragmentedPages keeps CHUNK_MAP_RESERVED_SLOTS free, this means the reserve is too small
+        uart_print_level_1("ERROR in allocChunkMapSlot: all the chunk map slots are in use\r\n");
+        while(1);
+    }
+    return slot;
+}
+
+static void freeChunkMapSlot(const UINT32 slot)
+{
+    write_dram_32(ChunkMapSlot(slot, 0), freeSlotsHead);
+    freeSlotsHead = slot;
+    nFreeSlotsInList++;
+}
+
+// Returns a lpn holding a chunk map slot if fewer than minFreeSlots slots are free, INVALID otherwise
+UINT32 chunksMapFragmentedLpn(const UINT32 minFreeSlots)
+{
+    UINT32 freeSlots = nFreeSlotsInList + (NUM_CHUNK_MAP_SLOTS - nextUnusedSlot);
+    if (freeSlots >= minFreeSlots)
+    {
+        return INVALID;
+    }
+    for (UINT32 i=0; i<NUM_MAPPED_LPNS; i++)
+    {
+        UINT32 lpn = fragmentedScanLpn;
+        fragmentedScanLpn = (fragmentedScanLpn + 1) % NUM_MAPPED_LPNS;
+        if (isChunkMapSlot(read_dram_32(PageMapTable(lpn))))
+        {
+            uart_print("chunksMapFragmentedLpn: free slots "); uart_print_int(freeSlots);
+            uart_print(", lpn "); uart_print_int(lpn); uart_print("\r\n");
+            return lpn;
+        }
+    }
+    return INVALID;
+}
+
+// Returns TRUE if the chunks can be mapped by the page entry alone, which is then stored in pageEntry
+static BOOL8 compressChunkAddrs(const UINT32 * chunkAddrs, UINT32 * pageEntry)
+{
+    UINT32 base = chunkAddrs[0];
+    if (base != INVALID && ((base & ContiguousPageFlag) || (base % CHUNKS_PER_PAGE) != 0))
+    {
+        return FALSE;
+    }
+    for (UINT32 chunkIdx=1; chunkIdx<CHUNKS_PER_PAGE; chunkIdx++)
+    {
+        if (chunkAddrs[chunkIdx] != (base == INVALID ? INVALID : base + chunkIdx))
+        {
+            return FALSE;
+        }
+    }
+    *pageEntry = (base == INVALID) ? INVALID : (base | ContiguousPageFlag);
+    return TRUE;
+}
+
+static void storeChunkAddrs(const UINT32 lpn, const UINT32 * chunkAddrs)
+{
+    UINT32 oldPageEntry = read_dram_32(PageMapTable(lpn));
+    UINT32 pageEntry;
+    if (compressChunkAddrs(chunkAddrs, &pageEntry))
+    {
+        if (isChunkMapSlot(oldPageEntry))
+        {
+            freeChunkMapSlot(oldPageEntry);
+        }
+    }
+    else
+    {
+        pageEntry = isChunkMapSlot(oldPageEntry) ? oldPageEntry : allocChunkMapSlot();
+        mem_copy(ChunkMapSlot(pageEntry, 0), chunkAddrs, CHUNKS_PER_PAGE * sizeof(UINT32));
+    }
+    write_dram_32(PageMapTable(lpn), pageEntry);
+}
+
+static void tableInit()
+{
+    uart_print("chunksMapInit: chunk map slots = "); uart_print_int(NUM_CHUNK_MAP_SLOTS); uart_print("\r\n");
+    mem_set_dram(PAGE_MAP_TABLE_ADDR, INVALID, PAGE_MAP_TABLE_BYTES);
+    freeSlotsHead = INVALID;
+    nFreeSlotsInList = 0;
+    nextUnusedSlot = 0;
+    fragmentedScanLpn = 0;
+}
+
+static BOOL8 tableWriteBackStep()
+{
+    return FALSE;
+}
+
+static void expandPageEntry(const UINT32 pageEntry, UINT32 * chunkAddrs)
+{
+    if (isChunkMapSlot(pageEntry))
+    {
+        mem_copy(chunkAddrs, ChunkMapSlot(pageEntry, 0), CHUNKS_PER_PAGE * sizeof(UINT32));
+        return;
+    }
+    for (UINT32 chunkIdx=0; chunkIdx<CHUNKS_PER_PAGE; chunkIdx++)
+    {
+        chunkAddrs[chunkIdx] = (pageEntry == INVALID) ? INVALID : (pageEntry & ~ContiguousPageFlag) + chunkIdx;
+    }
+}
+
+#if OPTION_MAP_ENTRY_CACHE == 0
+static UINT32 tableGetChunkAddr(const UINT32 lpn, const UINT32 chunkIdx)
+{
+    UINT32 pageEntry = read_dram_32(PageMapTable(lpn));
+    if (pageEntry == INVALID)
+    {
+        return INVALID;
+    }
+    if (pageEntry & ContiguousPageFlag)
+    {
+        return (pageEntry & ~ContiguousPageFlag) + chunkIdx;
+    }
+    return read_dram_32(ChunkMapSlot(pageEntry, chunkIdx));
+}
+#endif
+
+static void tableSetChunkAddr(const UINT32 lpn, const UINT32 chunkIdx, const UINT32 chunkAddr)
+{
+    UINT32 pageEntry = read_dram_32(PageMapTable(lpn));
+    UINT32 chunkAddrs[CHUNKS_PER_PAGE];
+    if (isChunkMapSlot(pageEntry))
+    {
+        write_dram_32(ChunkMapSlot(pageEntry, chunkIdx), chunkAddr);
+        // The slot can be released only if the page became all invalid or contiguous, check the cheap conditions first
+        if (chunkAddr == INVALID ||
+            ((chunkAddr % CHUNKS_PER_PAGE) == chunkIdx && read_dram_32(ChunkMapSlot(pageEntry, 0)) == chunkAddr - chunkIdx))
+        {
+            mem_copy(chunkAddrs, ChunkMapSlot(pageEntry, 0), CHUNKS_PER_PAGE * sizeof(UINT32));
+            storeChunkAddrs(lpn, chunkAddrs);
+        }
+        return;
+    }
+    expandPageEntry(pageEntry, chunkAddrs);
+    if (chunkAddrs[chunkIdx] == chunkAddr)
+    {
+        return;
+    }
+    chunkAddrs[chunkIdx] = chunkAddr;
+    storeChunkAddrs(lpn, chunkAddrs);
+}
+
+static void tableGetPageChunkAddrs(const UINT32 lpn, UINT32 * chunkAddrs)
+{
+    expandPageEntry(read_dram_32(PageMapTable(lpn)), chunkAddrs);
+}
+
+static void tableSetPageChunkAddrs(const UINT32 lpn, const UINT32 * chunkAddrs)
+{
+    storeChunkAddrs(lpn, chunkAddrs);
+}
+
+static UINT32 tableFindChunkIdx(const UINT32 lpn, const UINT32 chunkAddr)
+{
+    UINT32 pageEntry = read_dram_32(PageMapTable(lpn));
+    if (pageEntry == INVALID)
+    {
+        return CHUNKS_PER_PAGE;
+    }
+    if (pageEntry & ContiguousPageFlag)
+    {
+        UINT32 chunkIdx = chunkAddr - (pageEntry & ~ContiguousPageFlag);
+        return (chunkIdx < CHUNKS_PER_PAGE) ? chunkIdx : CHUNKS_PER_PAGE;
+    }
+    return mem_search_equ_dram_4_bytes(ChunkMapSlot(pageEntry, 0), CHUNKS_PER_PAGE, chunkAddr);
+}
+
+#else
+
+#define mapEntriesAddr(lpn, modify)     ChunksMapTable(lpn, 0)
+
+static void tableInit()
+{
+    mem_set_dram(CHUNKS_MAP_TABLE_ADDR, INVALID, CHUNKS_MAP_TABLE_BYTES);
+}
+
+static BOOL8 tableWriteBackStep()
+{
+    return FALSE;
+}
+
+#endif
+
+#if OPTION_COMPRESSED_MAP == 0
+
+#if OPTION_MAP_ENTRY_CACHE == 0
+static UINT32 tableGetChunkAddr(const UINT32 lpn, const UINT32 chunkIdx)
+{
+    return read_dram_32(mapEntriesAddr(lpn, FALSE) + (chunkIdx * sizeof(UINT32)));
+}
+#endif
+
+static void tableSetChunkAddr(const UINT32 lpn, const UINT32 chunkIdx, const UINT32 chunkAddr)
+{
+    write_dram_32(mapEntriesAddr(lpn, TRUE) + (chunkIdx * sizeof(UINT32)), chunkAddr);
+}
+
+static void tableGetPageChunkAddrs(const UINT32 lpn, UINT32 * chunkAddrs)
+{
+    mem_copy(chunkAddrs, mapEntriesAddr(lpn, FALSE), CHUNKS_PER_PAGE * sizeof(UINT32));
+}
+
+static void tableSetPageChunkAddrs(const UINT32 lpn, const UINT32 * chunkAddrs)
+{
+    mem_copy(mapEntriesAddr(lpn, TRUE), chunkAddrs, CHUNKS_PER_PAGE * sizeof(UINT32));
+}
+
+static UINT32 tableFindChunkIdx(const UINT32 lpn, const UINT32 chunkAddr)
+{
+    return mem_search_equ_dram_4_bytes(mapEntriesAddr(lpn, FALSE), CHUNKS_PER_PAGE, chunkAddr);
+}
+
+#endif
+
+/* Map entry cache.
+ * With OPTION_MAP_ENTRY_CACHE the entries of recently used lpns are kept in a set-associative cache in SRAM,
+ * one line per lpn holding all its CHUNKS_PER_PAGE entries. Lines are replaced in LRU order within a set and
+ * written back to the map table only when evicted or on chunksMapWriteBack.
+ * Reads allocate a line, while updates and searches of lpns that are not cached go straight to the table:
+ * GC searches the map of every lpn in the victim block once, and would otherwise flush the cache. */
+
+#if OPTION_MAP_ENTRY_CACHE
+
+#define MapCacheSet(lpn)                ((lpn) % MAP_CACHE_SETS)
+
+static UINT32 mapCacheLpn[MAP_CACHE_SETS][MAP_CACHE_WAYS];
+static UINT32 mapCacheEntries[MAP_CACHE_SETS][MAP_CACHE_WAYS][CHUNKS_PER_PAGE];
+static UINT32 mapCacheLastUse[MAP_CACHE_SETS][MAP_CACHE_WAYS];
+static UINT8 mapCacheDirty[MAP_CACHE_SETS][MAP_CACHE_WAYS];
+static UINT32 mapCacheUseClock;
+static UINT32 mapCacheWriteBackSet;
+
+static UINT32 findMapCacheWay(const UINT32 lpn)
+{
+    UINT32 way = mem_search_equ_sram_4_bytes(mapCacheLpn[MapCacheSet(lpn)], MAP_CACHE_WAYS, lpn);
+    if (way < MAP_CACHE_WAYS)
+    {
+        mapCacheHits++;
+        mapCacheLastUse[MapCacheSet(lpn)][way] = ++mapCacheUseClock;
+    }
+    else
+    {
+        mapCacheMisses++;
+    }
+    return way;
+}
+
+static void writeBackMapCacheLine(const UINT32 set, const UINT32 way)
+{
+    if (mapCacheDirty[set][way])
+    {
+        tableSetPageChunkAddrs(mapCacheLpn[set][way], mapCacheEntries[set][way]);
+        mapCacheDirty[set][way] = 0;
+    }
+}
+
+static UINT32 * mapCacheLine(const UINT32 lpn)
+{
+    UINT32 set = MapCacheSet(lpn);
+    UINT32 way = findMapCacheWay(lpn);
+    if (way >= MAP_CACHE_WAYS)
+    {
+        way = 0;
+        for (UINT32 i=1; i<MAP_CACHE_WAYS; i++)
+        {
+            if (mapCacheLastUse[set][i] < mapCacheLastUse[set][way])
+            {
+                way = i;
+            }
+        }
+        if (mapCacheLpn[set][way] != INVALID)
+        {
+            writeBackMapCacheLine(set, way);
+        }
+        tableGetPageChunkAddrs(lpn, mapCacheEntries[set][way]);
+        mapCacheLpn[set][way] = lpn;
+        mapCacheLastUse[set][way] = ++mapCacheUseClock;
+    }
+    return mapCacheEntries[set][way];
+}
+
+void chunksMapInit()
+{
+    tableInit();
+    uart_print("chunksMapInit: map cache lines = "); uart_print_int(MAP_CACHE_SETS * MAP_CACHE_WAYS); uart_print("\r\n");
+    for (UINT32 set=0; set<MAP_CACHE_SETS; set++)
+    {
+        for (UINT32 way=0; way<MAP_CACHE_WAYS; way++)
+        {
+            mapCacheLpn[set][way] = INVALID;
+            mapCacheLastUse[set][way] = 0;
+            mapCacheDirty[set][way] = 0;
+        }
+    }
+    mapCacheUseClock = 0;
+    mapCacheWriteBackSet = 0;
+    mapCacheHits = 0;
+    mapCacheMisses = 0;
+}
+
+void chunksMapWriteBack()
+{
+    for (UINT32 set=0; set<MAP_CACHE_SETS; set++)
+    {
+        for (UINT32 way=0; way<MAP_CACHE_WAYS; way++)
+        {
+            if (mapCacheLpn[set][way] != INVALID)
+            {
+                writeBackMapCacheLine(set, way);
+            }
+        }
+    }
+}
+
+// One bounded slice of write-back for idle time: one dirty cache line, or else one dirty translation page.
+BOOL8 chunksMapWriteBackStep()
+{
+    for (UINT32 i=0; i<MAP_CACHE_SETS; i++)
+    {
+        UINT32 set = (mapCacheWriteBackSet + i) % MAP_CACHE_SETS;
+        for (UINT32 way=0; way<MAP_CACHE_WAYS; way++)
+        {
+            if (mapCacheDirty[set][way])
+            {
+                writeBackMapCacheLine(set, way);
+                mapCacheWriteBackSet = (set + 1) % MAP_CACHE_SETS;
+                return TRUE;
+            }
+        }
+    }
+    return tableWriteBackStep();
+}
+
+UINT32 getChunkAddr(const UINT32 lpn, const UINT32 chunkIdx)
+{
+    return mapCacheLine(lpn)[chunkIdx];
+}
+
+void setChunkAddr(const UINT32 lpn, const UINT32 chunkIdx, const UINT32 chunkAddr)
+{
+    UINT32 way = findMapCacheWay(lpn);
+    if (way < MAP_CACHE_WAYS)
+    {
+        mapCacheEntries[MapCacheSet(lpn)][way][chunkIdx] = chunkAddr;
+        mapCacheDirty[MapCacheSet(lpn)][way] = 1;
+    }
+    else
+    {
+        tableSetChunkAddr(lpn, chunkIdx, chunkAddr);
+    }
+}
+
+// chunkAddrs must hold CHUNKS_PER_PAGE entries
+void getPageChunkAddrs(const UINT32 lpn, UINT32 * chunkAddrs)
+{
+    mem_copy(chunkAddrs, mapCacheLine(lpn), CHUNKS_PER_PAGE * sizeof(UINT32));
+}
+
+void setPageChunkAddrs(const UINT32 lpn, const UINT32 * chunkAddrs)
+{
+    UINT32 way = findMapCacheWay(lpn);
+    if (way < MAP_CACHE_WAYS)
+    {
+        mem_copy(mapCacheEntries[MapCacheSet(lpn)][way], chunkAddrs, CHUNKS_PER_PAGE * sizeof(UINT32));
+        mapCacheDirty[MapCacheSet(lpn)][way] = 1;
+    }
+    else
+    {
+        tableSetPageChunkAddrs(lpn, chunkAddrs);
+    }
+}
+
+// Returns the index of the chunk of lpn mapped to chunkAddr, or CHUNKS_PER_PAGE if there is none
+UINT32 findChunkIdx(const UINT32 lpn, const UINT32 chunkAddr)
+{
+    UINT32 way = findMapCacheWay(lpn);
+    if (way < MAP_CACHE_WAYS)
+    {
+        return mem_search_equ_sram_4_bytes(mapCacheEntries[MapCacheSet(lpn)][way], CHUNKS_PER_PAGE, chunkAddr);
+    }
+    return tableFindChunkIdx(lpn, chunkAddr);
+}
+
+#else
+
+void chunksMapInit()
+{
+    tableInit();
+}
+
+void chunksMapWriteBack()
+{
+}
+
+BOOL8 chunksMapWriteBackStep()
+{
+    return tableWriteBackStep();
+}
+
+UINT32 getChunkAddr(const UINT32 lpn, const UINT32 chunkIdx)
+{
+    return tableGetChunkAddr(lpn, chunkIdx);
+}
+
+void setChunkAddr(const UINT32 lpn, const UINT32 chunkIdx, const UINT32 chunkAddr)
+{
+    tableSetChunkAddr(lpn, chunkIdx, chunkAddr);
+}
+
+// chunkAddrs must hold CHUNKS_PER_PAGE entries
+void getPageChunkAddrs(const UINT32 lpn, UINT32 * chunkAddrs)
+{
+    tableGetPageChunkAddrs(lpn, chunkAddrs);
+}
+
+void setPageChunkAddrs(const UINT32 lpn, const UINT32 * chunkAddrs)
+{
+    tableSetPageChunkAddrs(lpn, chunkAddrs);
+}
+
+// Returns the index of the chunk of lpn mapped to chunkAddr, or CHUNKS_PER_PAGE if there is none
+UINT32 findChunkIdx(const UINT32 lpn, const UINT32 chunkAddr)
+{
+    return tableFindChunkIdx(lpn, chunkAddr);
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef CHUNKS_MAP_H
+#define CHUNKS_MAP_H
+#include "jasmine.h"
+
+void chunksMapInit();
+void chunksMapWriteBack();
+BOOL8 chunksMapWriteBackStep();
+void set_map_vbn(UINT32 const bank, UINT32 const mapBlk, UINT32 const vblock);
+UINT32 getChunkAddr(const UINT32 lpn, const UINT32 chunkIdx);
+void setChunkAddr(const UINT32 lpn, const UINT32 chunkIdx, const UINT32 chunkAddr);
+void getPageChunkAddrs(const UINT32 lpn, UINT32 * chunkAddrs);
+void setPageChunkAddrs(const UINT32 lpn, const UINT32 * chunkAddrs);
+UINT32 findChunkIdx(const UINT32 lpn, const UINT32 chunkAddr);
+#if OPTION_COMPRESSED_MAP
+UINT32 chunksMapFragmentedLpn(const UINT32 minFreeSlots);
+#endif
+
+#endif
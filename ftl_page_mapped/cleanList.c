@@ -1,5 +1,6 @@
 #include "cleanList.h"
 #include "ftl_metadata.h"
+#include "dram_layout.h" // LogBlkEraseCount
 
 #if OPTION_UART_DEBUG == 1
     #if OPTION_UART_DEBUG_LIST == 0
@@ -8,6 +9,127 @@
     #endif
 #endif
 
+#if OPTION_CLEAN_LIST_RING
+
+/* The clean blocks of every bank are kept in a ring of 16 bit lbns in DRAM, pushed at the tail and popped from the head
+ * in the same order as the linked lists, so push and pop are a single DRAM access and no pointer is followed.
+ * An SRAM bitmap marks the clean blocks: it catches a block pushed twice and lets the wear-aware variant scan the clean
+ * blocks without the ring.
+ * With OPTION_WEAR_AWARE_CLEAN_LIST every push counts an erase of the block, since GC pushes a victim right after
+ * erasing it and the format pushes each block once. Pop then returns the clean block with the fewest erases and the
+ * ring is not used. */
+
+#define CleanBmpWords                   ((LOG_BLK_PER_BANK + 31) / 32)
+#define isCleanBlk(data, bank, lbn)     (((data)->cleanBmp[bank][(lbn) / 32] & ((UINT32)1 << ((lbn) % 32))) != 0)
+
+static UINT32 ringEntryAddr(listData * data, const UINT32 bank, const UINT32 idx)
+{
+    return data->ringAddr + ((bank * data->ringCapacity) + (idx % data->ringCapacity)) * sizeof(UINT16);
+}
+
+#if OPTION_WEAR_AWARE_CLEAN_LIST
+static UINT32 leastErasedCleanBlk(listData * data, const UINT32 bank)
+{
+    UINT32 bestLbn = INVALID;
+    UINT32 bestErases = INVALID;
+    for (UINT32 word=0; word<CleanBmpWords; word++)
+    {
+        UINT32 bits = data->cleanBmp[bank][word];
+        for (UINT32 bit=0; bits != 0; bit++, bits >>= 1)
+        {
+            if (bits & 1)
+            {
+                UINT32 lbn = word * 32 + bit;
+                UINT32 erases = read_dram_16(LogBlkEraseCount(bank, lbn));
+                if (erases < bestErases)
+                {
+                    bestLbn = lbn;
+                    bestErases = erases;
+                }
+            }
+        }
+    }
+    uart_print("leastErasedCleanBlk bank "); uart_print_int(bank); uart_print(": lbn "); uart_print_int(bestLbn);
+    uart_print(" erased "); uart_print_int(bestErases); uart_print(" times\r\n");
+    return bestLbn;
+}
+#endif
+
+void cleanListInit(listData * data, UINT32 startAddr, UINT32 numNodesPerBank)
+{
+    uart_print("cleanListInit: ring at "); uart_print_int(startAddr);
+    uart_print(", entries per bank = "); uart_print_int(numNodesPerBank); uart_print("\r\n");
+    data->ringAddr = startAddr;
+    data->ringCapacity = numNodesPerBank;
+    for (UINT32 bank=0; bank<NUM_BANKS; bank++)
+    {
+        data->ringHead[bank] = 0;
+        data->size[bank] = 0;
+    }
+    mem_set_sram(data->cleanBmp, 0, sizeof(data->cleanBmp));
+}
+
+void cleanListPush(listData * data, UINT32 bank, UINT32 logLbn)
+{
+    uart_print("cleanListPush bank "); uart_print_int(bank);
+    uart_print(". Lbn "); uart_print_int(logLbn); uart_print("\r\n");
+    if (logLbn >= LOG_BLK_PER_BANK || isCleanBlk(data, bank, logLbn))
+    {
+        uart_print_level_1("error in cleanListPush on bank "); uart_print_level_1_int(bank);
+        uart_print_level_1(": lbn "); uart_print_level_1_int(logLbn); uart_print_level_1(" is already clean\r\n");
+        while(1);
+    }
+    if (data->size[bank] == data->ringCapacity)
+    {
+        uart_print_level_1("error in cleanListPush on bank ");
+        uart_print_level_1_int(bank);
+        uart_print_level_1(": list is full\r\n");
+        while(1);
+    }
+    data->cleanBmp[bank][logLbn / 32] |= ((UINT32)1 << (logLbn % 32));
+#if OPTION_WEAR_AWARE_CLEAN_LIST
+    UINT32 erases = read_dram_16(LogBlkEraseCount(bank, logLbn));
+    if (erases < 0xFFFF)
+    {
+        write_dram_16(LogBlkEraseCount(bank, logLbn), erases + 1);
+    }
+#else
+    write_dram_16(ringEntryAddr(data, bank, data->ringHead[bank] + data->size[bank]), logLbn);
+#endif
+    data->size[bank]++;
+}
+
+UINT32 cleanListPop(listData * data, UINT32 bank)
+{
+    uart_print("cleanListPop bank="); uart_print_int(bank); uart_print("\r\n");
+    if (data->size[bank] == 0)
+    {
+        uart_print_level_1("error in cleanListPop on bank ");
+        uart_print_level_1_int(bank);
+        uart_print_level_1(": list is empty\r\n");
+        while(1);
+    }
+#if OPTION_WEAR_AWARE_CLEAN_LIST
+    UINT32 logLbn = leastErasedCleanBlk(data, bank);
+#else
+    UINT32 logLbn = read_dram_16(ringEntryAddr(data, bank, data->ringHead[bank]));
+    data->ringHead[bank] = (data->ringHead[bank] + 1) % data->ringCapacity;
+#endif
+    if (logLbn >= LOG_BLK_PER_BANK || !isCleanBlk(data, bank, logLbn))
+    {
+        uart_print_level_1("ERROR in cleanListPop on bank "); uart_print_level_1_int(bank);
+        uart_print_level_1(": lbn "); uart_print_level_1_int(logLbn); uart_print_level_1(" is not clean\r\n");
+        while(1);
+    }
+    data->cleanBmp[bank][logLbn / 32] &= ~((UINT32)1 << (logLbn % 32));
+    data->size[bank]--;
+    uart_print("cleanListPop bank "); uart_print_int(bank);
+    uart_print(". Lbn "); uart_print_int(logLbn); uart_print("\r\n");
+    return logLbn;
+}
+
+#else
+
 void cleanListInit(listData * data, UINT32 startAddr, UINT32 numNodesPerBank)
 {
     uart_print("cleanListInit: startAddr = "); uart_print_int(startAddr);
@@ -123,6 +245,8 @@ UINT32 cleanListPop(listData * data, UINT32 bank)
     return logLbn;
 }
 
+#endif
+
 /*
 UINT32 cleanListSize(listData * data, UINT32 bank)
 {
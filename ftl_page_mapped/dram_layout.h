@@ -39,6 +39,17 @@
 
 #define CHUNKS_MAP_TABLE_ADDR                       (LOG_BMT_ADDR + LOG_BMT_BYTES)
 
+#if OPTION_DEMAND_PAGED_MAP
+#define CACHED_MAP_ADDR                             CHUNKS_MAP_TABLE_ADDR
+
+#define MAP_DIR_ADDR                                (CACHED_MAP_ADDR + CACHED_MAP_BYTES)
+
+#elif OPTION_COMPRESSED_MAP
+#define PAGE_MAP_TABLE_ADDR                         CHUNKS_MAP_TABLE_ADDR
+
+#define CHUNK_MAP_SLOTS_ADDR                        (PAGE_MAP_TABLE_ADDR + PAGE_MAP_TABLE_BYTES)
+
+#endif
 #define HEAP_VALID_CHUNKS_ADDR_FIRST_USAGE          (CHUNKS_MAP_TABLE_ADDR + CHUNKS_MAP_TABLE_BYTES)
 
 #define HEAP_VALID_CHUNKS_POSITIONS_FIRST_USAGE     (HEAP_VALID_CHUNKS_ADDR_FIRST_USAGE + HEAP_VALID_CHUNKS_BYTES)
@@ -59,7 +70,33 @@
 
 #define OW_COUNT_ADDR                               (PRECACHE_FOR_ENCODING + PRECACHE_FOR_ENCODING_BYTES)
 
-#define END_ADDR                                    (OW_COUNT_ADDR + OW_COUNT_BYTES)
+#define READ_CACHE_ADDR                             (OW_COUNT_ADDR + OW_COUNT_BYTES)
+
+#define READ_AHEAD_BUF_ADDR                         (READ_CACHE_ADDR + READ_CACHE_BYTES)
+
+#define PENDING_MERGE_BUF_ADDR                      (READ_AHEAD_BUF_ADDR + READ_AHEAD_BUF_BYTES)
+
+#define PENDING_MERGE_READ_BUF_ADDR                 (PENDING_MERGE_BUF_ADDR + PENDING_MERGE_BUF_BYTES)
+
+#define SECTOR_OVERLAY_ADDR                         (PENDING_MERGE_READ_BUF_ADDR + PENDING_MERGE_READ_BUF_BYTES)
+
+#define COLD_STREAMS_BUF_ADDR                       (SECTOR_OVERLAY_ADDR + SECTOR_OVERLAY_BYTES)    // log buffers of the cold streams after the first one
+
+#define COLD_STREAMS_LPNS_ADDR                      (COLD_STREAMS_BUF_ADDR + COLD_STREAMS_BUF_BYTES)
+
+#define LOG_BLK_STREAM_ADDR                         (COLD_STREAMS_LPNS_ADDR + COLD_STREAMS_LPNS_BYTES)    // cold stream that last wrote each log block
+
+#define PAGE_VALID_SUMMARY_ADDR                     (LOG_BLK_STREAM_ADDR + LOG_BLK_STREAM_BYTES)    // chunks that may still be valid in each log page
+
+#define LOG_BLK_ERASE_COUNT_ADDR                    (PAGE_VALID_SUMMARY_ADDR + PAGE_VALID_SUMMARY_BYTES)    // erases of each log block since the format
+
+#define TEMPERATURE_FILTERS_ADDR                    (LOG_BLK_ERASE_COUNT_ADDR + LOG_BLK_ERASE_COUNT_BYTES)    // bloom filters of the temperature detector
+
+#define END_ADDR                                    (TEMPERATURE_FILTERS_ADDR + TEMPERATURE_FILTERS_BYTES)
+
+// The regions depend on sizeof, so they are checked with array sizes instead of #if: the build fails when the chunk geometry does not fit DRAM.
+typedef char dramOtherBytesFit[(DRAM_BYTES_OTHER + NUM_BANKS * 2 * BYTES_PER_PAGE <= DRAM_SIZE) ? 1 : -1]; // at least a read and a write buffer per bank
+typedef char dramLayoutFits[(END_ADDR <= DRAM_BASE + DRAM_SIZE) ? 1 : -1];
 
 //////////////////////////
 // Buffer access macros //
@@ -74,16 +111,43 @@
 #define GC_BUF(BANK)                                    (GC_BUF_ADDR +  + ((BANK) * BYTES_PER_PAGE))
 #define HOT_LOG_BUF(BANK)                               (HOT_LOG_BUF_ADDR + ((BANK) * BYTES_PER_PAGE))
 #define COLD_LOG_BUF(BANK)                              (COLD_LOG_BUF_ADDR + ((BANK) * BYTES_PER_PAGE))
+#define SECOND_LOG_BUF(FIRST_BUF)                       ((FIRST_BUF) + (NUM_BANKS * BYTES_PER_PAGE)) // pair of HOT_LOG_BUF or COLD_LOG_BUF with OPTION_DOUBLE_LOG_BUFFERS
 #define LPNS_BUF_BASE_1(bank)                           (LPNS_IN_LOG_1_ADDR + ((bank)*CHUNKS_PER_BLK*CHUNK_ADDR_BYTES))
 #define LPNS_BUF_BASE_2(bank)                           (LPNS_IN_LOG_2_ADDR + ((bank)*CHUNKS_PER_BLK*CHUNK_ADDR_BYTES))
 #define LPNS_BUF_BASE_3(bank)                           (LPNS_IN_LOG_3_ADDR + ((bank)*CHUNKS_PER_BLK*CHUNK_ADDR_BYTES))
+#define COLD_STREAM_LOG_BUF(stream, bank)               ((stream) == 0 ? COLD_LOG_BUF(bank) : (COLD_STREAMS_BUF_ADDR + ((stream) - 1) * LOG_BUF_BYTES + ((bank) * BYTES_PER_PAGE)))
+#define COLD_STREAM_LPNS_BUF(stream, bank)              ((stream) == 0 ? LPNS_BUF_BASE_2(bank) : (COLD_STREAMS_LPNS_ADDR + ((stream) - 1) * LPNS_IN_LOG_BYTES + ((bank)*CHUNKS_PER_BLK*CHUNK_ADDR_BYTES)))
+#define LogBlkStream(bank, lbn)                         (LOG_BLK_STREAM_ADDR + ((bank) * LOG_BLK_PER_BANK + (lbn)) * sizeof(UINT8))
+#define BlkValidSummary(bank, lbn)                      (PAGE_VALID_SUMMARY_ADDR + ((bank) * LOG_BLK_PER_BANK + (lbn)) * PAGES_PER_BLK * sizeof(UINT8))
+#define PageValidSummary(chunkAddr)                     (PAGE_VALID_SUMMARY_ADDR + ((chunkAddr) / CHUNKS_PER_PAGE) * sizeof(UINT8)) // chunkAddr of a chunk in a flash log page
+#define LogBlkEraseCount(bank, lbn)                     (LOG_BLK_ERASE_COUNT_ADDR + ((bank) * LOG_BLK_PER_BANK + (lbn)) * sizeof(UINT16))
+#define TemperatureFilter(filter)                       (TEMPERATURE_FILTERS_ADDR + (filter) * ((1 << TEMPERATURE_FILTER_BITS_LOG2) / 8))
 #define chunkInLpnsList(base, logPageOffset, chunk)     ((base) + ((logPageOffset)*CHUNKS_PER_PAGE*CHUNK_ADDR_BYTES) + ((chunk) * CHUNK_ADDR_BYTES))
 #define VICTIM_LPN_LIST(bank)                           (VICTIM_LPN_LIST_ADDR + ((bank) * BYTES_PER_PAGE))
 #define ValidChunksAddr(startAddr, bank, pos)           ((startAddr) + ((bank) * LOG_BLK_PER_BANK * sizeof(heapEl)) + (pos) * sizeof(heapEl))
+#if OPTION_CLEAN_LIST_RING
+#define CleanList(bank)                                 (CLEAN_LIST_NODES_ADDR + ((bank) * LOG_BLK_PER_BANK * sizeof(UINT16)))
+#else
 #define CleanList(bank)                                 (CLEAN_LIST_NODES_ADDR + ((bank) * LOG_BLK_PER_BANK * sizeof(logListNode)))
+#endif
 #define HeapPositions(base, bank, blk)                  ( (base) + ( ( (bank) * LOG_BLK_PER_BANK + (blk) ) * sizeof(UINT32) ) )
+#if OPTION_DEMAND_PAGED_MAP
+#define CachedMapPage(slot)                             (CACHED_MAP_ADDR + ((slot) * BYTES_PER_PAGE))
+#define MapDir(mapPage)                                 (MAP_DIR_ADDR + ((mapPage) * sizeof(UINT32)))
+#elif OPTION_COMPRESSED_MAP
+#define PageMapTable(lpn)                               (PAGE_MAP_TABLE_ADDR + ((lpn) * sizeof(UINT32)))
+#define ChunkMapSlot(slot, chunkIdx)                    (CHUNK_MAP_SLOTS_ADDR + (slot) * CHUNKS_PER_PAGE * sizeof(UINT32) + (chunkIdx) * sizeof(UINT32))
+#else
 #define ChunksMapTable(lpn, chunkIdx)                   (CHUNKS_MAP_TABLE_ADDR + (lpn) * CHUNKS_PER_PAGE * sizeof(UINT32) + (chunkIdx) * sizeof(UINT32))
-#define PrecacheForEncoding(bank)                       (PRECACHE_FOR_ENCODING + ((bank) * BYTES_PER_PAGE))
+#endif
+#define PrecacheForEncodingSlot(bank, slot)             (PRECACHE_FOR_ENCODING + (((bank) * NUM_PRECACHE_SLOTS + (slot)) * BYTES_PER_PAGE))
+#define PrecacheForEncoding(bank)                       PrecacheForEncodingSlot(bank, 0)
+#define ReadCacheBuf(slot)                              (READ_CACHE_ADDR + ((slot) * BYTES_PER_PAGE))
+#define ReadAheadBuf(buf)                               (READ_AHEAD_BUF_ADDR + ((buf) * BYTES_PER_PAGE))
+#define ReadAheadStage(buf, stage)                      (READ_AHEAD_BUF_ADDR + ((NUM_READ_AHEAD_BUFFERS + (buf) * NUM_READ_AHEAD_STAGE_PAGES + (stage)) * BYTES_PER_PAGE))
+#define PendingMergeBuf(slot)                           (PENDING_MERGE_BUF_ADDR + ((slot) * BYTES_PER_CHUNK))
+#define PendingMergeReadBuf(slot)                       (PENDING_MERGE_READ_BUF_ADDR + ((slot) * ENCODED_CHUNK_BYTES))
+#define OverlayBuf(slot)                                (SECTOR_OVERLAY_ADDR + ((slot) * BYTES_PER_CHUNK))
 
 #define OwCounter(bank, blk, page)                      ( OW_COUNT_ADDR + ( ( (bank) * LOG_BLK_PER_BANK + blk ) * OwCountersPerBlk + (page) ) * sizeof(UINT8) )
 #define resetOwCounter(bank, blk)                       ( mem_set_dram(OW_COUNT_ADDR + ( ( (bank) * LOG_BLK_PER_BANK + blk) * OwCountersPerBlk ) * sizeof(UINT8), 0, OwCountersPerBlk * sizeof(UINT8) ) )
@@ -49,6 +49,13 @@
 #include "write.h"
 #include "flash.h" // RETURN_ON_ISSUE RETURN_WHEN_DONE
 #include "garbage_collection.h"
+#include "readCache.h"
+#include "readAhead.h"
+#include "chunksMap.h"
+#include "pendingMerge.h"
+#include "sectorOverlay.h"
+#include "temperature.h"
+#include "hostHints.h"
 
 //----------------------------------
 // FTL internal function prototype
@@ -58,6 +65,7 @@ static void build_bad_blk_list (void);
 static BOOL32 is_bad_block (UINT32 const bank, UINT32 const vblk_offset);
 static void format (void);
 static void init_metadata_sram (void);
+static void init_striping (void);
 static void set_bad_block (UINT32 const bank, UINT32 const vblk_offset);
 static void trimRange(const UINT32 lba, const UINT32 nSectors);
 
@@ -230,7 +238,25 @@ void ftl_open (void)
     uart_print_level_1_int(CHUNKS_PER_RECYCLED_PAGE);
     uart_print_level_1("\r\n");
 
-#if CanReuseBlksForColdData
+#if OPTION_COLD_REUSE
+    uart_print_level_1("Reuse blks for cold data with few valid low chunks\r\n");
+
+    uart_print_level_1("coldReuseMaxValidInit ");
+    uart_print_level_1_int(coldReuseMaxValidInit);
+    uart_print_level_1("\r\n");
+
+    uart_print_level_1("coldReuseMaxValidLimit ");
+    uart_print_level_1_int(coldReuseMaxValidLimit);
+    uart_print_level_1("\r\n");
+
+    uart_print_level_1("coldReuseGainShift ");
+    uart_print_level_1_int(coldReuseGainShift);
+    uart_print_level_1("\r\n");
+
+    uart_print_level_1("coldReuseMaxStep ");
+    uart_print_level_1_int(coldReuseMaxStep);
+    uart_print_level_1("\r\n");
+#elif CanReuseBlksForColdData
     uart_print_level_1("Can reuse blks for cold data\r\n");
 #else
     uart_print_level_1("Never reuse blks for cold data\r\n");
@@ -265,6 +291,16 @@ void ftl_open (void)
     uart_print_level_1_int(nSectsHotThreshold);
     uart_print_level_1("\r\n");
 
+#if OPTION_TEMPERATURE_DETECTOR
+    uart_print_level_1("temperatureHotThreshold ");
+    uart_print_level_1_int(temperatureHotThreshold);
+    uart_print_level_1("\r\n");
+
+    uart_print_level_1("temperatureDecayWrites ");
+    uart_print_level_1_int(temperatureDecayWrites);
+    uart_print_level_1("\r\n");
+#endif
+
     uart_print_level_1("CleanBlksBackgroundGcThreshold ");
     uart_print_level_1_int(CleanBlksBackgroundGcThreshold);
     uart_print_level_1("\r\n");
@@ -309,8 +345,29 @@ void ftl_open (void)
     uart_print_level_1_int(initStepDown);
     uart_print_level_1("\r\n");
 
+#if OPTION_FIXED_POINT_REUSE
+    uart_print_level_1("ReuseGain ");
+    uart_print_level_1_int(reuseGainNum);
+    uart_print_level_1(" >> ");
+    uart_print_level_1_int(reuseGainShift);
+    uart_print_level_1("\r\n");
+
+    uart_print_level_1("ReuseMaxStep ");
+    uart_print_level_1_int(reuseMaxStep);
+    uart_print_level_1("\r\n");
+
+    uart_print_level_1("ReuseThreshold ");
+    uart_print_level_1_int(reuseThresholdMin);
+    uart_print_level_1(" - ");
+    uart_print_level_1_int(reuseThresholdMax);
+    uart_print_level_1("\r\n");
+#endif
+
 #if WOMCanFail
     fprintf(logFile,"SuccessRateWOM %f\n", successRateWOM);
+    uart_print_level_1("WomMaxRetries ");
+    uart_print_level_1_int(womMaxRetries);
+    uart_print_level_1("\r\n");
     srand(time(NULL));
 #endif
 
@@ -342,7 +399,8 @@ void ftl_open (void)
     for (int i=0; i<NUM_BANKS; i++)
     {
         uart_print_level_1("Bank "); uart_print_level_1_int(i);
-        uart_print_level_1(" mapped to real bank "); uart_print_level_1_int(REAL_BANK(i)); uart_print_level_1("\r\n");
+        uart_print_level_1(" mapped to real bank "); uart_print_level_1_int(REAL_BANK(i));
+        uart_print_level_1(" channel "); uart_print_level_1_int(BankToChannel(i)); uart_print_level_1("\r\n");
     }
 
     uart_print("DRAM Address range: "); uart_print_int(DRAM_BASE); uart_print(" - "); uart_print_int(END_ADDR); uart_print("\r\n");
@@ -513,7 +571,7 @@ static void format (void)
     mem_set_dram (LOG_BMT_ADDR, NULL, LOG_BMT_BYTES);
     uart_print("done\r\n");
     uart_print("Initializing Chunks Map Table...");
-    mem_set_dram (CHUNKS_MAP_TABLE_ADDR, INVALID, CHUNKS_MAP_TABLE_BYTES);
+    chunksMapInit();
     uart_print("done\r\n");
 #if Overwrite
     uart_print("Initializing Overwrite Counters...");
@@ -524,6 +582,16 @@ static void format (void)
     mem_set_dram(LPNS_IN_LOG_1_ADDR, INVALID, LPNS_IN_LOG_BYTES);
     mem_set_dram(LPNS_IN_LOG_2_ADDR, INVALID, LPNS_IN_LOG_BYTES);
     mem_set_dram(LPNS_IN_LOG_3_ADDR, INVALID, LPNS_IN_LOG_BYTES);
+#if OPTION_LOG_STREAMS
+    mem_set_dram(COLD_STREAMS_LPNS_ADDR, INVALID, COLD_STREAMS_LPNS_BYTES);
+    mem_set_dram(LOG_BLK_STREAM_ADDR, 0, LOG_BLK_STREAM_BYTES);
+#endif
+#if OPTION_PAGE_VALID_SUMMARY
+    mem_set_dram(PAGE_VALID_SUMMARY_ADDR, INVALID, PAGE_VALID_SUMMARY_BYTES);
+#endif
+#if OPTION_WEAR_AWARE_CLEAN_LIST
+    mem_set_dram(LOG_BLK_ERASE_COUNT_ADDR, 0, LOG_BLK_ERASE_COUNT_BYTES);
+#endif
     uart_print("done\r\n");
     uart_print("DRAM initialization done\r\n");
     UINT32 lbn, vblock;
@@ -536,6 +604,32 @@ static void format (void)
         uart_print("Setting Log BMT...");
         uart_print("Initializing bank "); uart_print_int(bank); uart_print("\r\n");
         uart_print("\tReal bank "); uart_print_int(REAL_BANK(bank)); uart_print("\r\n");
+#if OPTION_DEMAND_PAGED_MAP
+        // map blocks are taken from the unused vblocks after the misc block
+        UINT32 mapBlk = 0;
+        for (UINT32 mapVblock = MISCBLK_VBN + 1; mapBlk < MAP_BLK_PER_BANK && mapVblock < vblock; mapVblock++)
+        {
+            if (is_bad_block (bank, mapVblock) == TRUE)
+            {
+                continue;
+            }
+            nand_block_erase_sync (bank, mapVblock);
+            if (g_bsp_isr_flag[bank] != INVALID)
+            {
+                set_bad_block (bank, g_bsp_isr_flag[bank]);
+                g_bsp_isr_flag[bank] = INVALID;
+                continue;
+            }
+            uart_print("\tMap block "); uart_print_int(mapBlk); uart_print(" assigned to vbn "); uart_print_int(mapVblock); uart_print("\r\n");
+            set_map_vbn(bank, mapBlk, mapVblock);
+            mapBlk++;
+        }
+        if (mapBlk < MAP_BLK_PER_BANK)
+        {
+            uart_print_level_1("ERROR in format: not enough good map blocks in bank "); uart_print_level_1_int(bank); uart_print_level_1("\r\n");
+            while(1);
+        }
+#endif
         for (lbn = 0; lbn < LOG_BLK_PER_BANK;)
         {
             vblock++;
@@ -883,6 +977,40 @@ static void uart_print_buf(const UINT32 startAddr, const UINT32 bytes)
 }
 */
 
+/* Groups the logical banks by the channel they are wired to (BANK_MAP), and builds the order in
+ * which consecutive writes are spread over the banks: with OPTION_CHANNEL_FIRST_STRIPING one way
+ * of every channel is used before moving to the next way, otherwise all the ways of a channel
+ * are used before moving to the next channel. */
+static void init_striping (void)
+{
+    UINT32 nWays[NUM_CHANNELS];
+    for (UINT32 channel = 0; channel < NUM_CHANNELS; channel++)
+    {
+        nWays[channel] = 0;
+    }
+    for (UINT32 bank = 0; bank < NUM_BANKS; bank++)
+    {
+        UINT32 channel = BankToChannel(bank);
+        if (channel >= NUM_CHANNELS || nWays[channel] >= WAYS_PER_CHANNEL)
+        {
+            uart_print_level_1("ERROR in init_striping: bank "); uart_print_level_1_int(bank);
+            uart_print_level_1(" on channel "); uart_print_level_1_int(channel); uart_print_level_1(" does not fit NUM_CHANNELS\r\n");
+            while(1);
+        }
+        channelBank[channel][nWays[channel]] = bank;
+        bankWay[bank] = nWays[channel];
+        nWays[channel]++;
+    }
+    for (UINT32 pos = 0; pos < NUM_BANKS; pos++)
+    {
+#if OPTION_CHANNEL_FIRST_STRIPING
+        stripeBank[pos] = channelBank[pos % NUM_CHANNELS][pos / NUM_CHANNELS];
+#else
+        stripeBank[pos] = channelBank[pos / WAYS_PER_CHANNEL][pos % WAYS_PER_CHANNEL];
+#endif
+    }
+}
+
 static void init_metadata_sram (void)
 {
     uart_print("initialize metadata in SRAM...");
@@ -891,6 +1019,7 @@ static void init_metadata_sram (void)
         free_list_head[bank]=0;
         free_list_tail[bank]=0;
     }
+    init_striping();
     uart_print(" done\r\n");
 
     uart_print("Initializing heap first usage...");
@@ -914,11 +1043,89 @@ static void init_metadata_sram (void)
     uart_print("Initializing log...");
     initLog();
     uart_print("done\r\n");
+
+#if OPTION_READ_CACHE
+    uart_print("Initializing read cache...");
+    readCacheInit();
+    uart_print("done\r\n");
+#endif
+
+#if OPTION_READ_AHEAD
+    uart_print("Initializing read-ahead...");
+    readAheadInit();
+    uart_print("done\r\n");
+#endif
+
+#if OPTION_ASYNC_RMW
+    uart_print("Initializing pending merges...");
+    pendingMergeInit();
+    uart_print("done\r\n");
+#endif
+
+#if OPTION_SECTOR_OVERLAY
+    uart_print("Initializing sector overlay...");
+    sectorOverlayInit();
+    uart_print("done\r\n");
+#endif
+
+#if OPTION_TEMPERATURE_DETECTOR
+    uart_print("Initializing temperature detector...");
+    temperatureInit();
+    uart_print("done\r\n");
+#endif
+
+#if OPTION_HOST_HINTS
+    uart_print("Initializing host hints...");
+    hostHintsInit();
+    uart_print("done\r\n");
+#endif
 }
 
-// flush FTL metadata(SRAM+DRAM) for normal POR
+/* Empties the volatile write cache, for FLUSH CACHE, standby/idle and writes that must not be cached.
+ * The partially filled log buffers are programmed with their missing chunks marked invalid. Hot is flushed before
+ * cold, since a failed WOM reprogram moves the hot chunks to the cold buffer, and flushing may trigger a GC that
+ * fills some cold buffer again, so we repeat until a whole pass finds nothing buffered. Then we wait only for the
+ * banks that were programmed. The FTL is formatted at every power on (see ftl_open), so there is no recovery
+ * metadata to persist: the map write-back only makes the DRAM map coherent. */
 void ftl_flush (void)
-{}
+{
+    uart_print("ftl_flush\r\n");
+    UINT32 dirtyBanks = 0;
+    BOOL8 flushed;
+#if OPTION_SECTOR_OVERLAY
+    sectorOverlayFlush(); // the merged chunks go to the cold log buffers flushed below
+#endif
+    do
+    {
+        flushed = FALSE;
+        for (UINT32 bank=0; bank<NUM_BANKS; bank++)
+        {
+            if (flushPartialLogBuffer(hotLogCtrl, bank))
+            {
+                dirtyBanks |= ((UINT32)1 << bank);
+                flushed = TRUE;
+            }
+            for (UINT32 stream=0; stream<NUM_COLD_STREAMS; stream++)
+            {
+                if (flushPartialLogBuffer(coldStreamCtrl[stream], bank))
+                {
+                    dirtyBanks |= ((UINT32)1 << bank);
+                    flushed = TRUE;
+                }
+            }
+        }
+    } while (flushed);
+
+    chunksMapWriteBack();
+
+    for (UINT32 bank=0; bank<NUM_BANKS; bank++)
+    {
+        if (dirtyBanks & ((UINT32)1 << bank))
+        {
+            waitBusyBank(bank);
+        }
+    }
+}
 
 
 void ftl_isr (void)
@@ -1062,6 +1269,12 @@ static void trimRange(const UINT32 lba, const UINT32 nSectors)
             uart_print_level_1("Warning0 on trimRange\r\n");
             count=0;
         }
+#if OPTION_READ_CACHE
+        readCacheInvalidate(lpn);
+#endif
+#if OPTION_READ_AHEAD
+        readAheadInvalidate(lpn);
+#endif
         UINT32 chunkIdx = sectOffset / SECTORS_PER_CHUNK;
         int count1=0;
         while (remainingSectors != 0 && chunkIdx < CHUNKS_PER_PAGE)
@@ -1080,11 +1293,10 @@ static void trimRange(const UINT32 lba, const UINT32 nSectors)
             }
             else
             {
-                if (ChunksMapTable(lpn , chunkIdx) > DRAM_BASE + DRAM_SIZE)
-                {
-                    uart_print_level_1("ERROR in trimRange 1: reading above DRAM address space\r\n");
-                }
-                UINT32 oldChunkAddr = read_dram_32(ChunksMapTable(lpn , chunkIdx));
+                UINT32 oldChunkAddr = getChunkAddr(lpn , chunkIdx);
+#if OPTION_SECTOR_OVERLAY
+                sectorOverlayDrop(lpn, chunkIdx);
+#endif
                 switch (findChunkLocation(oldChunkAddr))
                 {
                     case Invalid:
@@ -1097,6 +1309,9 @@ static void trimRange(const UINT32 lba, const UINT32 nSectors)
                         decrementValidChunks(&heapDataFirstUsage, oldChunkBank, ChunkToLbn(oldChunkAddr));
                         decrementValidChunks(&heapDataSecondUsage, oldChunkBank, ChunkToLbn(oldChunkAddr));
                         decrementValidChunks(&heapDataCold, oldChunkBank, ChunkToLbn(oldChunkAddr));
+#if OPTION_PAGE_VALID_SUMMARY
+                        clearChunkValidSummary(oldChunkAddr);
+#endif
                     } break;
                     case FlashWLogEncoded:
                     {
@@ -1104,6 +1319,9 @@ static void trimRange(const UINT32 lba, const UINT32 nSectors)
                         decrementValidChunks(&heapDataFirstUsage, oldChunkBank, ChunkToLbn(oldChunkAddr));
                         decrementValidChunks(&heapDataSecondUsage, oldChunkBank, ChunkToLbn(oldChunkAddr));
                         decrementValidChunks(&heapDataCold, oldChunkBank, ChunkToLbn(oldChunkAddr));
+#if OPTION_PAGE_VALID_SUMMARY
+                        clearChunkValidSummary(oldChunkAddr);
+#endif
                     } break;
                     case DRAMHotLog:
                     {
@@ -1112,11 +1330,12 @@ static void trimRange(const UINT32 lba, const UINT32 nSectors)
                     } break;
                     case DRAMColdLog:
                     {
-                        UINT32 oldChunkBank = ChunkToBank(oldChunkAddr);
-                        coldLogCtrl[oldChunkBank].dataLpn[oldChunkAddr % CHUNKS_PER_PAGE] = INVALID;
+                        UINT32 realOldChunkAddr = oldChunkAddr & ~(ColdLogBufBitFlag);
+                        UINT32 oldChunkBank = ChunkToBank(realOldChunkAddr);
+                        ColdStreamCtrlOfBufChunk(realOldChunkAddr)[oldChunkBank].dataLpn[realOldChunkAddr % CHUNKS_PER_PAGE] = INVALID;
                     } break;
                 }
-                write_dram_32(ChunksMapTable(lpn, chunkIdx), INVALID);
+                setChunkAddr(lpn, chunkIdx, INVALID);
             }
             remainingSectors-=nSectsToTrim;
             chunkIdx++;
@@ -1130,6 +1349,21 @@ static void trimRange(const UINT32 lba, const UINT32 nSectors)
 const UINT32 overwriteBitMask = ((0x00000001) << overwriteBitPosition);
 const UINT32 overwriteLbaMask = ~((0xFFFFFFFF) << overwriteBitPosition);
 
+// Sector range of the host write being processed, a read overlapping it cannot preempt the write path.
+static UINT32 writeInProgressLba = 0;
+static UINT32 writeInProgressSects = 0;
+
+BOOL32 ftl_read_can_preempt (UINT32 const lba, UINT32 const num_sectors)
+{
+    UINT32 readLba = lba & overwriteLbaMask;
+    if (readLba + num_sectors <= writeInProgressLba || readLba >= writeInProgressLba + writeInProgressSects)
+    {
+        return TRUE;
+    }
+    uart_print("ftl_read_can_preempt: read overlaps write in progress\r\n");
+    return FALSE;
+}
+
 void ftl_read (UINT32 const lba, UINT32 const num_sectors)
 {
     //uart_print_level_1("r "); uart_print_level_1_int(lba); uart_print_level_1(" "); uart_print_level_1_int(num_sectors); uart_print_level_1("\r\n");
@@ -1151,6 +1385,10 @@ void ftl_read (UINT32 const lba, UINT32 const num_sectors)
         lpn++;
     }
 
+#if OPTION_READ_AHEAD
+    readAheadDetectStream(lba & overwriteLbaMask, num_sectors);
+#endif
+
     //UINT32 bank = lpn % NUM_BANKS;
     //backgroundCleaning(0);
 }
@@ -1161,6 +1399,8 @@ void ftl_write_cold (UINT32 const lba, UINT32 const nSects)
     uart_print("\r\n\r\nftl_write_cold lba="); uart_print_int(lba);
     uart_print(", num_sectors="); uart_print_int(nSects); uart_print("\r\n");
     userSecWrites += nSects;
+    writeInProgressLba = lba;
+    writeInProgressSects = nSects;
 
     UINT32 lpn = lba / SECTORS_PER_PAGE;
     UINT32 sectOffset = lba % SECTORS_PER_PAGE;
@@ -1185,6 +1425,9 @@ void ftl_write_cold (UINT32 const lba, UINT32 const nSects)
             else
             { nSectsToWrite = SECTORS_PER_CHUNK;}
         }
+#if OPTION_TEMPERATURE_DETECTOR
+        temperatureRecordWrite(lpn, sectOffset / SECTORS_PER_CHUNK); // the hint chooses the log, the detector still sees the write
+#endif
         writeToLogBlk(ctrlBlock, lpn, sectOffset, nSectsToWrite);
         sectOffset = (sectOffset + nSectsToWrite) % SECTORS_PER_PAGE;
         remainingSects -= nSectsToWrite;
@@ -1202,6 +1445,7 @@ void ftl_write_cold (UINT32 const lba, UINT32 const nSects)
         SETREG (BM_STACK_WRSET, g_ftl_write_buf_id);
         SETREG (BM_STACK_RESET, 0x01);
     }
+    writeInProgressSects = 0;
 }
 
 void ftl_write_hot (UINT32 const lba, UINT32 const nSects)
@@ -1210,6 +1454,8 @@ void ftl_write_hot (UINT32 const lba, UINT32 const nSects)
     uart_print("\r\n\r\nftl_write_hot lba="); uart_print_int(lba);
     uart_print(", num_sectors="); uart_print_int(nSects); uart_print("\r\n");
     userSecWrites += nSects;
+    writeInProgressLba = lba;
+    writeInProgressSects = nSects;
 
     UINT32 lpn = lba / SECTORS_PER_PAGE;
     UINT32 sectOffset = lba % SECTORS_PER_PAGE;
@@ -1234,6 +1480,9 @@ void ftl_write_hot (UINT32 const lba, UINT32 const nSects)
             else
             { nSectsToWrite = SECTORS_PER_CHUNK;}
         }
+#if OPTION_TEMPERATURE_DETECTOR
+        temperatureRecordWrite(lpn, sectOffset / SECTORS_PER_CHUNK); // the hint chooses the log, the detector still sees the write
+#endif
         writeToLogBlk(ctrlBlock, lpn, sectOffset, nSectsToWrite);
         sectOffset = (sectOffset + nSectsToWrite) % SECTORS_PER_PAGE;
         remainingSects -= nSectsToWrite;
@@ -1251,6 +1500,7 @@ void ftl_write_hot (UINT32 const lba, UINT32 const nSects)
         SETREG (BM_STACK_WRSET, g_ftl_write_buf_id);
         SETREG (BM_STACK_RESET, 0x01);
     }
+    writeInProgressSects = 0;
 
 }
 
@@ -1263,6 +1513,8 @@ void ftl_write (UINT32 const lba, UINT32 const nSects)
     start_interval_measurement(TIMER_CH2, TIMER_PRESCALE_0);
     #endif
     userSecWrites += nSects;
+    writeInProgressLba = lba;
+    writeInProgressSects = nSects;
 
     UINT32 lpn = lba / SECTORS_PER_PAGE;
     UINT32 sectOffset = lba % SECTORS_PER_PAGE;
@@ -1309,6 +1561,11 @@ void ftl_write (UINT32 const lba, UINT32 const nSects)
             else
             { nSectsToWrite = SECTORS_PER_CHUNK;}
         }
+#if OPTION_TEMPERATURE_DETECTOR
+        // Hot chunks go to the hot log, whose blocks are the ones reused, cold chunks to the cold log.
+        temperatureRecordWrite(lpn, sectOffset / SECTORS_PER_CHUNK);
+        ctrlBlock = temperatureIsHot(lpn, sectOffset / SECTORS_PER_CHUNK) ? hotLogCtrl : coldLogCtrl;
+#endif
         writeToLogBlk(ctrlBlock, lpn, sectOffset, nSectsToWrite);
         sectOffset = (sectOffset + nSectsToWrite) % SECTORS_PER_PAGE;
         remainingSects -= nSectsToWrite;
@@ -1326,6 +1583,7 @@ void ftl_write (UINT32 const lba, UINT32 const nSects)
         SETREG (BM_STACK_WRSET, g_ftl_write_buf_id);
         SETREG (BM_STACK_RESET, 0x01);
     }
+    writeInProgressSects = 0;
 
 #if MeasureW
     UINT32 timerValue=GET_TIMER_VALUE(TIMER_CH2);
@@ -45,6 +45,7 @@ void ftl_write_cold (UINT32 const lba, UINT32 const num_sectors);
 void ftl_write_hot (UINT32 const lba, UINT32 const num_sectors);
 void ftl_write (UINT32 const lba, UINT32 const num_sectors);
 void ftl_trim (UINT32 const lba, UINT32 const num_sectors);
+BOOL32 ftl_read_can_preempt (UINT32 const lba, UINT32 const num_sectors);
 //void ftl_test_write (UINT32 const lba, UINT32 const num_sectors);
 void ftl_flush (void);
 void ftl_isr (void);
@@ -28,13 +28,20 @@ listData cleanListDataWrite;
 
 UINT32 userSecWrites = 0;
 UINT32 totSecWrites = 0;
+UINT32 mapCacheHits = 0;
+UINT32 mapCacheMisses = 0;
 
-LogCtrlBlock coldLogCtrl[NUM_BANKS];
+LogCtrlBlock coldStreamCtrl[NUM_COLD_STREAMS][NUM_BANKS];
+UINT8 gcStream[NUM_BANKS];
 LogCtrlBlock hotLogCtrl[NUM_BANKS];
 
 UINT32 free_list_head[NUM_BANKS];
 UINT32 free_list_tail[NUM_BANKS];
 
+UINT8 stripeBank[NUM_BANKS];
+UINT8 channelBank[NUM_CHANNELS][WAYS_PER_CHANNEL];
+UINT8 bankWay[NUM_BANKS];
+
 
 BOOL8 gcState[NUM_BANKS];
 UINT32 victimLbn[NUM_BANKS];
@@ -55,6 +62,7 @@ UINT32 CleanBlksBackgroundGcThreshold = 1;
 UINT32 nValidChunksInPageToReuseThreshold = 0;
 #if WOMCanFail
 float successRateWOM = 100.0;
+UINT32 womMaxRetries = 1;       // failed WOM programs of the same chunks retried on the next page of the block before they go to the cold log
 #endif
 UINT32 adaptiveWindowSize = 5;
 UINT32 adaptiveWindow[NUM_BANKS][5];
@@ -66,3 +74,34 @@ UINT32 maxStepUps = 7;
 UINT32 maxStepDowns = 7;
 UINT32 initStepUp = 1;
 UINT32 initStepDown = 1;
+#if OPTION_FIXED_POINT_REUSE || OPTION_COLD_REUSE
+UINT32 adaptiveWindowSum[NUM_BANKS];    // running sum of adaptiveWindow, updated when GC pushes a new value
+UINT32 adaptiveWindowRecip;             // 65536 / adaptiveWindowSize rounded to nearest, the window average costs a multiplication
+#endif
+#if OPTION_FIXED_POINT_REUSE
+UINT32 hotFirstAccumulatedFx[NUM_BANKS]; // hotFirstAccumulated with ReuseFxShift fractional bits
+UINT32 reuseGainNum = 1;        // threshold step in blocks = (window average - validMin) in chunks * reuseGainNum >> reuseGainShift
+UINT32 reuseGainShift = 9;
+UINT32 reuseMaxStep = 2;        // largest threshold change per hot block allocation, in blocks
+UINT32 reuseThresholdMin = 4;   // bounds of hotFirstAccumulated
+UINT32 reuseThresholdMax = 112;
+UINT32 reuseCtrlUpdates[NUM_BANKS];     // telemetry: controller updates
+UINT32 reuseCtrlAbsErr[NUM_BANKS];      // telemetry: moving average of |window average - validMin|, with ReuseFxShift fractional bits
+UINT32 reuseCtrlSignChanges[NUM_BANKS]; // telemetry: updates whose step had the opposite direction of the previous one
+BOOL8 reuseCtrlLastUp[NUM_BANKS];
+#endif
+#if OPTION_COLD_REUSE
+UINT32 coldReuseMaxValid[NUM_BANKS];    // valid low page chunks a first usage hot block may still have to be reused by a cold stream
+UINT32 coldReuseMaxValidInit = CHUNKS_PER_OW_LOG_BLK / 8;
+UINT32 coldReuseMaxValidLimit = CHUNKS_PER_OW_LOG_BLK / 2;
+UINT32 coldReuseGainShift = 2;          // bound step in chunks = |window average - valid chunks of the cold reused victim| >> coldReuseGainShift
+UINT32 coldReuseMaxStep = 16;           // largest bound change per cold reused victim, in chunks
+UINT32 coldReuseBlks[NUM_BANKS];        // telemetry: first usage hot blocks reused by cold streams
+#endif
+UINT32 readAheadDepth = 4;      // pages prefetched ahead of a sequential stream, at most NUM_READ_AHEAD_BUFFERS
+UINT32 readAheadTrigger = 2;    // consecutive sequential reads needed before a stream is prefetched
+UINT32 gcPreemptReadsPerStep = 1; // host reads served between two GC page moves
+UINT32 gcPreemptMaxReads = 32;    // host reads served during one garbageCollectLog call, after that GC runs to completion
+UINT32 temperatureHotThreshold = 2;   // filters of the temperature detector that must contain a chunk for it to be hot
+UINT32 temperatureDecayWrites = 4096; // chunk writes recorded before the oldest filter of the temperature detector is cleared, at most 1/16 of the filter bits
+UINT32 mapWriteBackBatch = 8;     // dirty translation pages written back together when a dirty one is evicted from the cached map
@@ -24,6 +24,7 @@ typedef struct LogCtrlBlock
     UINT8 allChunksInLogAreValid;
     UINT8 useRecycledPage;
     UINT8 precacheDone;
+    UINT8 stream;       // index in coldStreamCtrl, 0 for the hot log
 } LogCtrlBlock;
 
 
@@ -39,9 +40,16 @@ typedef struct heapData
 
 typedef struct listData
 {
+#if OPTION_CLEAN_LIST_RING
+    UINT32 ringAddr;                                        // DRAM ring of lbns, ringCapacity entries per bank
+    UINT32 ringCapacity;
+    UINT32 ringHead[NUM_BANKS];                             // oldest clean block, the ring holds size[bank] lbns from here
+    UINT32 cleanBmp[NUM_BANKS][(LOG_BLK_PER_BANK + 31) / 32]; // one bit per log block, set while the block is clean
+#else
     logListNode* cleanListHead[NUM_BANKS];
     logListNode* cleanListTail[NUM_BANKS];
     logListNode* cleanListUnusedNodes[NUM_BANKS];
+#endif
     UINT32 size[NUM_BANKS];
 } listData;
 
@@ -74,7 +82,13 @@ extern heapData heapDataCold;
 extern listData cleanListDataWrite;
 extern UINT32 userSecWrites;
 extern UINT32 totSecWrites;
-extern LogCtrlBlock coldLogCtrl[NUM_BANKS];
+extern UINT32 mapCacheHits;
+extern UINT32 mapCacheMisses;
+extern LogCtrlBlock coldStreamCtrl[NUM_COLD_STREAMS][NUM_BANKS]; // cold stream 0 receives the host cold writes, the others GC relocations
+#define coldLogCtrl         (coldStreamCtrl[0])
+extern UINT8 gcStream[NUM_BANKS];                                   // cold stream receiving the chunks moved by the current GC of the bank
+#define gcLogCtrl(bank)     (coldStreamCtrl[gcStream[bank]])
+#define ColdStreamCtrlOfBufChunk(chunk) (coldStreamCtrl[ColdStreamOfBufChunk(chunk)]) // cold stream whose DRAM buffer holds the chunk (ColdLogBufBitFlag cleared)
 extern LogCtrlBlock hotLogCtrl[NUM_BANKS];
 extern UINT32 free_list_head[NUM_BANKS];
 extern UINT32 free_list_tail[NUM_BANKS];
@@ -89,6 +103,7 @@ extern UINT32 CleanBlksBackgroundGcThreshold;
 extern UINT32 nValidChunksInPageToReuseThreshold;
 #if WOMCanFail
 extern float successRateWOM;
+extern UINT32 womMaxRetries;
 #endif
 extern UINT32 adaptiveWindowSize;
 extern UINT32 adaptiveWindow[NUM_BANKS][5];
@@ -100,6 +115,45 @@ extern UINT32 maxStepUps;
 extern UINT32 maxStepDowns;
 extern UINT32 initStepUp;
 extern UINT32 initStepDown;
+#if OPTION_FIXED_POINT_REUSE || OPTION_COLD_REUSE
+extern UINT32 adaptiveWindowSum[NUM_BANKS];
+extern UINT32 adaptiveWindowRecip;
+// Average of the adaptive window of the bank with fracBits fractional bits, rounded to nearest.
+#define AdaptiveWindowAvg(bank, fracBits)   ((adaptiveWindowSum[bank] * adaptiveWindowRecip + ((UINT32)1 << (15 - (fracBits)))) >> (16 - (fracBits)))
+#endif
+#if OPTION_FIXED_POINT_REUSE
+#define ReuseFxShift    8
+extern UINT32 hotFirstAccumulatedFx[NUM_BANKS];
+extern UINT32 reuseGainNum;
+extern UINT32 reuseGainShift;
+extern UINT32 reuseMaxStep;
+extern UINT32 reuseThresholdMin;
+extern UINT32 reuseThresholdMax;
+extern UINT32 reuseCtrlUpdates[NUM_BANKS];
+extern UINT32 reuseCtrlAbsErr[NUM_BANKS];
+extern UINT32 reuseCtrlSignChanges[NUM_BANKS];
+extern BOOL8 reuseCtrlLastUp[NUM_BANKS];
+#endif
+#if OPTION_COLD_REUSE
+extern UINT32 coldReuseMaxValid[NUM_BANKS];
+extern UINT32 coldReuseMaxValidInit;
+extern UINT32 coldReuseMaxValidLimit;
+extern UINT32 coldReuseGainShift;
+extern UINT32 coldReuseMaxStep;
+extern UINT32 coldReuseBlks[NUM_BANKS];
+#endif
+extern UINT32 readAheadDepth;
+extern UINT32 readAheadTrigger;
+extern UINT32 gcPreemptReadsPerStep;
+extern UINT32 gcPreemptMaxReads;
+extern UINT32 temperatureHotThreshold;
+extern UINT32 temperatureDecayWrites;
+extern UINT32 mapWriteBackBatch;
+
+#define WAYS_PER_CHANNEL    (NUM_BANKS / NUM_CHANNELS)
+extern UINT8 stripeBank[NUM_BANKS];                         // logical bank at each position of the striping order
+extern UINT8 channelBank[NUM_CHANNELS][WAYS_PER_CHANNEL];   // logical bank of each way of a channel
+extern UINT8 bankWay[NUM_BANKS];                            // way of the bank inside its channel
 
 
 #define GcIdle  0
@@ -134,6 +188,7 @@ extern UINT32 victimLbn[NUM_BANKS];
 #define DataPageToDataBlk(dataLpn)      (((dataLpn) / NUM_BANKS) / PAGES_PER_BLK)
 #define DataPageToOffset(dataLpn)       (((dataLpn) / NUM_BANKS) % PAGES_PER_BLK)
 #define PageToBank(lpn)                 ((lpn) % NUM_BANKS)
+#define BankToChannel(bank)             (REAL_BANK(bank) % NUM_CHNLS_MAX)
 #define VPageToOffset(vpn)              ((vpn) % PAGES_PER_BLK)
 #define VPageToVBlk(vpn)                ((vpn) / PAGES_PER_BLK)
 #define LogPageToOffset(logLpn)         ((logLpn) % PAGES_PER_BLK)
@@ -12,10 +12,14 @@
 #define SECTORS_PER_OW_VBLK             (SECTORS_PER_PAGE * UsedPagesPerOwLogBlk)
 
 //------------------------------------------
-// Parameters for 4KB Log chunking
+// Parameters for Log chunking
 //------------------------------------------
-#define CHUNKS_PER_PAGE                     8  // 4KB chunks
-#define CHUNKS_PER_RECYCLED_PAGE            4  // 4KB chunks
+// The chunk size is chosen at build time (make CHUNK_KB=8), every chunk parameter below is derived from it.
+#ifndef CHUNK_KB
+#define CHUNK_KB                            4  // 4, 8 or 16 KB chunks
+#endif
+#define CHUNKS_PER_PAGE                     (BYTES_PER_PAGE / (CHUNK_KB * 1024))  // 8 with 4KB chunks
+#define CHUNKS_PER_RECYCLED_PAGE            (CHUNKS_PER_PAGE / 2)                 // 4 with 4KB chunks
 #define CHUNKS_PER_BLK                      (CHUNKS_PER_PAGE * PAGES_PER_BLK)
 #define CHUNKS_PER_LOG_BLK                  (UsedPagesPerLogBlk * CHUNKS_PER_PAGE) // 126 pages are used because the last low-high couple is used for lpns lists
 //
@@ -36,9 +40,19 @@
 #define CHUNKS_PER_OW_LOG_BLK               (UsedPagesPerOwLogBlk * CHUNKS_PER_PAGE)
 #define CHUNK_ADDR_BYTES                    (sizeof(UINT32))
 #define SECTORS_PER_CHUNK                   (SECTORS_PER_PAGE / CHUNKS_PER_PAGE)
-#define SECTORS_PER_ENCODED_CHUNK           (21)
+#define SECTORS_PER_ENCODED_CHUNK           ((SECTORS_PER_CHUNK * 21) / 8) // the encoding stores 8 sectors of data in 21 sectors
 #define BYTES_PER_CHUNK                     (BYTES_PER_PAGE / CHUNKS_PER_PAGE)
 
+#if (CHUNK_KB * 1024) > BYTES_PER_PAGE || BYTES_PER_PAGE % (CHUNK_KB * 1024) != 0
+#error("CHUNK_KB must divide the page size")
+#endif
+#if CHUNKS_PER_RECYCLED_PAGE < 1 || ((CHUNKS_PER_RECYCLED_PAGE - 1) * SECTORS_PER_CHUNK + SECTORS_PER_ENCODED_CHUNK) > SECTORS_PER_PAGE
+#error("encoded chunks do not fit in a recycled page, use smaller chunks")
+#endif
+#if SECTORS_PER_CHUNK > 32
+#error("the sector bitmaps of the sector overlay hold at most 32 sectors per chunk")
+#endif
+
 
 
 //-------------------------------
@@ -109,7 +123,11 @@
 #define NUM_GC_BUFFERS          (NUM_BANKS)
 #define NUM_HIL_BUFFERS         1
 #define NUM_TEMP_BUFFERS        1
+#if OPTION_DOUBLE_LOG_BUFFERS
+#define NUM_LOG_BUFFERS         (2 * NUM_BANKS) // two per bank, see SECOND_LOG_BUF
+#else
 #define NUM_LOG_BUFFERS         NUM_BANKS
+#endif
 #define NUM_OW_LOG_BUFFERS      NUM_BANKS
 
 #define COPY_BUF_BYTES                      (NUM_COPY_BUFFERS * BYTES_PER_PAGE)                                                                           // 1 MB
@@ -123,16 +141,111 @@
 #define BAD_BLK_BMP_BYTES                   (((NUM_VBLKS / 8) + DRAM_ECC_UNIT - 1) / DRAM_ECC_UNIT * DRAM_ECC_UNIT)
 #define HEAP_VALID_CHUNKS_BYTES             ((NUM_BANKS * LOG_BLK_PER_BANK * sizeof(heapEl) + DRAM_ECC_UNIT -1) / DRAM_ECC_UNIT * DRAM_ECC_UNIT)         // 2,560 B
 #define HEAP_VALID_CHUNKS_POSITIONS_BYTES   ((NUM_BANKS * LOG_BLK_PER_BANK * sizeof(UINT32) + DRAM_ECC_UNIT - 1) / DRAM_ECC_UNIT * DRAM_ECC_UNIT)   // 8 KB
+#if OPTION_CLEAN_LIST_RING
+#define CLEAN_LIST_NODES_BYTES              ((NUM_BANKS * LOG_BLK_PER_BANK * sizeof(UINT16) + DRAM_ECC_UNIT -1) / DRAM_ECC_UNIT * DRAM_ECC_UNIT)          // 16 KB, ring of lbns per bank
+#else
 #define CLEAN_LIST_NODES_BYTES              ((NUM_BANKS * LOG_BLK_PER_BANK * sizeof(logListNode) + DRAM_ECC_UNIT -1) / DRAM_ECC_UNIT * DRAM_ECC_UNIT)     // 2,560 B
+#endif
+#if OPTION_WEAR_AWARE_CLEAN_LIST
+#if OPTION_CLEAN_LIST_RING == 0
+#error("OPTION_WEAR_AWARE_CLEAN_LIST needs the clean bitmap of OPTION_CLEAN_LIST_RING")
+#endif
+#define LOG_BLK_ERASE_COUNT_BYTES           ((NUM_BANKS * LOG_BLK_PER_BANK * sizeof(UINT16) + DRAM_ECC_UNIT -1) / DRAM_ECC_UNIT * DRAM_ECC_UNIT)          // 16 KB
+#else
+#define LOG_BLK_ERASE_COUNT_BYTES           0
+#endif
 #define RECYCLED_CLEAN_LIST_NODES_BYTES     ((NUM_BANKS * MaxRecycledBlocks * sizeof(logListNode) + DRAM_ECC_UNIT -1) / DRAM_ECC_UNIT * DRAM_ECC_UNIT)     // 2,560 B
-#define PRECACHE_FOR_ENCODING_BYTES         (NUM_BANKS * BYTES_PER_PAGE)
+#if OPTION_PRECACHE_RING
+#define NUM_PRECACHE_SLOTS                  4                                                                                                           // low pages read ahead per bank
+#else
+#define NUM_PRECACHE_SLOTS                  1
+#endif
+#define PRECACHE_FOR_ENCODING_BYTES         (NUM_BANKS * NUM_PRECACHE_SLOTS * BYTES_PER_PAGE)
 #if Overwrite
 #define OW_COUNT_BYTES                      ( ( ( NUM_BANKS * LOG_BLK_PER_BANK * OwCountersPerBlk * sizeof(UINT8) ) + DRAM_ECC_UNIT - 1 ) / DRAM_ECC_UNIT * DRAM_ECC_UNIT )
 #else
 #define OW_COUNT_BYTES                      0
 #endif
 
-#define CHUNKS_MAP_TABLE_BYTES              (NUM_BANKS * DATA_BLK_PER_BANK * PAGES_PER_VBLK * CHUNKS_PER_PAGE * sizeof(UINT32))
+#if OPTION_READ_CACHE
+#define NUM_READ_CACHE_PAGES                32                                                                                                          // 1 MB
+#else
+#define NUM_READ_CACHE_PAGES                0
+#endif
+#define READ_CACHE_BYTES                    (NUM_READ_CACHE_PAGES * BYTES_PER_PAGE)
+#if OPTION_READ_AHEAD
+#define NUM_READ_AHEAD_BUFFERS              8                                                                                                           // 256 KB
+#define NUM_READ_AHEAD_STAGE_PAGES          2                                                                                                           // per buffer, flash pages holding several chunks of the prefetched page, 512 KB
+#else
+#define NUM_READ_AHEAD_BUFFERS              0
+#define NUM_READ_AHEAD_STAGE_PAGES          0
+#endif
+#define READ_AHEAD_BUF_BYTES                (NUM_READ_AHEAD_BUFFERS * (1 + NUM_READ_AHEAD_STAGE_PAGES) * BYTES_PER_PAGE)
+#define NUM_READ_STREAMS                    4
+#if OPTION_ASYNC_RMW
+#define NUM_PENDING_MERGES                  16                                                                                                          // 64 KB
+#else
+#define NUM_PENDING_MERGES                  0
+#endif
+#define PENDING_MERGE_BUF_BYTES             (NUM_PENDING_MERGES * BYTES_PER_CHUNK)
+#define ENCODED_CHUNK_BYTES                 (SECTORS_PER_ENCODED_CHUNK * BYTES_PER_SECTOR)
+#define PENDING_MERGE_READ_BUF_BYTES        (NUM_PENDING_MERGES * ENCODED_CHUNK_BYTES)                                                                 // 168 KB
+#if OPTION_SECTOR_OVERLAY
+#define NUM_OVERLAY_SLOTS                   64                                                                                                          // 256 KB
+#else
+#define NUM_OVERLAY_SLOTS                   0
+#endif
+#define SECTOR_OVERLAY_BYTES                (NUM_OVERLAY_SLOTS * BYTES_PER_CHUNK)
+#if OPTION_LOG_STREAMS
+#define NUM_COLD_STREAMS                    3                                                                                                           // host cold writes, then one stream per GC age
+#define LOG_BLK_STREAM_BYTES                (((NUM_BANKS * LOG_BLK_PER_BANK * sizeof(UINT8)) + DRAM_ECC_UNIT - 1) / DRAM_ECC_UNIT * DRAM_ECC_UNIT)          // 8 KB
+#else
+#define NUM_COLD_STREAMS                    1
+#define LOG_BLK_STREAM_BYTES                0
+#endif
+#define COLD_STREAMS_BUF_BYTES              ((NUM_COLD_STREAMS - 1) * LOG_BUF_BYTES)                                                                    // 2 MB
+#define COLD_STREAMS_LPNS_BYTES             ((NUM_COLD_STREAMS - 1) * LPNS_IN_LOG_BYTES)                                                                // 128 KB
+#define NUM_TEMPERATURE_FILTERS             4                                                                                                           // bloom filters of the temperature detector, kept in DRAM
+#define TEMPERATURE_FILTER_BITS_LOG2        16                                                                                                          // 8 KB per filter, 16 bits per write of a temperatureDecayWrites window
+#define TEMPERATURE_FILTER_HASHES           3                                                                                                           // bits set per recorded chunk write
+#if OPTION_TEMPERATURE_DETECTOR
+#define TEMPERATURE_FILTERS_BYTES           (NUM_TEMPERATURE_FILTERS * (1 << TEMPERATURE_FILTER_BITS_LOG2) / 8)                                         // 32 KB
+#else
+#define TEMPERATURE_FILTERS_BYTES           0
+#endif
+#if OPTION_PAGE_VALID_SUMMARY
+#define PAGE_VALID_SUMMARY_BYTES            (NUM_BANKS * LOG_BLK_PER_BANK * PAGES_PER_BLK * sizeof(UINT8))                                              // 1 MB, one bit per chunk, CHUNKS_PER_PAGE <= 8
+#else
+#define PAGE_VALID_SUMMARY_BYTES            0
+#endif
+#define NUM_HOST_HINT_RANGES                16                                                                                                          // lba ranges tagged by the host, kept in SRAM
+
+#define CHUNKS_MAP_ENTRIES_BYTES            (NUM_BANKS * DATA_BLK_PER_BANK * PAGES_PER_VBLK * CHUNKS_PER_PAGE * sizeof(UINT32))
+#if OPTION_DEMAND_PAGED_MAP
+// The map table is split in translation pages of one flash page each, stored in the map blocks.
+// Only NUM_CACHED_MAP_PAGES of them are kept in DRAM, together with the directory of their flash locations.
+#define LPNS_PER_MAP_PAGE                   (BYTES_PER_PAGE / (CHUNKS_PER_PAGE * sizeof(UINT32)))
+#define NUM_MAP_PAGES                       ((CHUNKS_MAP_ENTRIES_BYTES + BYTES_PER_PAGE - 1) / BYTES_PER_PAGE)
+#define NUM_CACHED_MAP_PAGES                64                                                                                                          // 2 MB
+#define CACHED_MAP_BYTES                    (NUM_CACHED_MAP_PAGES * BYTES_PER_PAGE)
+#define MAP_DIR_BYTES                       (((NUM_MAP_PAGES * sizeof(UINT32)) + 127) / 128 * 128)
+#define CHUNKS_MAP_TABLE_BYTES              (CACHED_MAP_BYTES + MAP_DIR_BYTES)
+#elif OPTION_COMPRESSED_MAP
+// One page entry per lpn. Lpns whose chunks are not stored contiguously get a chunk map slot with one entry per chunk.
+// When fewer than twice CHUNK_MAP_RESERVED_SLOTS slots are free, ftl_write rewrites fragmented lpns as contiguous pages
+// through the GC stream. The reserve covers what one host chunk write can fragment before the next check: two GC
+// victims on every bank, plus the dirty lines of the map entry cache.
+#define NUM_MAPPED_LPNS                     (NUM_BANKS * DATA_BLK_PER_BANK * PAGES_PER_VBLK)
+#define PAGE_MAP_TABLE_BYTES                (NUM_MAPPED_LPNS * sizeof(UINT32))
+#define NUM_CHUNK_MAP_SLOTS                 (NUM_MAPPED_LPNS / 4)
+#define CHUNK_MAP_RESERVED_SLOTS            (2 * NUM_BANKS * CHUNKS_PER_BLK + MAP_CACHE_SETS * MAP_CACHE_WAYS)
+#define CHUNK_MAP_SLOTS_BYTES               (NUM_CHUNK_MAP_SLOTS * CHUNKS_PER_PAGE * sizeof(UINT32))
+#define CHUNKS_MAP_TABLE_BYTES              (PAGE_MAP_TABLE_BYTES + CHUNK_MAP_SLOTS_BYTES)
+#else
+#define CHUNKS_MAP_TABLE_BYTES              CHUNKS_MAP_ENTRIES_BYTES
+#endif
+#define MAP_CACHE_SETS                      16 // SRAM cache of map entries, one line per lpn
+#define MAP_CACHE_WAYS                      4
 
 #define DRAM_BYTES_OTHER    (COPY_BUF_BYTES + \
                             FTL_BUF_BYTES + \
@@ -157,7 +270,18 @@
                             CLEAN_LIST_NODES_BYTES + \
                             CLEAN_LIST_NODES_BYTES + \
                             PRECACHE_FOR_ENCODING_BYTES + \
-                            OW_COUNT_BYTES)
+                            OW_COUNT_BYTES + \
+                            READ_CACHE_BYTES + \
+                            READ_AHEAD_BUF_BYTES + \
+                            PENDING_MERGE_BUF_BYTES + \
+                            PENDING_MERGE_READ_BUF_BYTES + \
+                            SECTOR_OVERLAY_BYTES + \
+                            COLD_STREAMS_BUF_BYTES + \
+                            COLD_STREAMS_LPNS_BYTES + \
+                            LOG_BLK_STREAM_BYTES + \
+                            PAGE_VALID_SUMMARY_BYTES + \
+                            LOG_BLK_ERASE_COUNT_BYTES + \
+                            TEMPERATURE_FILTERS_BYTES)
 
 #define LOG_METADATA_BYTES      ((NUM_FTL_BUFFERS + NUM_GC_BUFFERS + NUM_LOG_BUFFERS + NUM_OW_LOG_BUFFERS) * BYTES_PER_PAGE)
 #define HASH_METADATA_BYTES     (HASH_BUCKET_BYTES + HASH_NODE_BYTES)
@@ -230,6 +354,9 @@ typedef struct logListNode
 // |----LOG----|LogBufLpn|OwLogBuf|~~~~~~|---OW LOG---|
 #define StartLogLpn         0
 #define DramLogBufLpn        ((LOG_BLK_PER_BANK)*(PAGES_PER_BLK)-1)
+// The DRAM buffer of cold stream s is addressed as the last page of log block LOG_BLK_PER_BANK-1-s: that page holds the lpns list and never chunks.
+#define ColdStreamBufLpn(stream)        (DramLogBufLpn - ((stream) * PAGES_PER_BLK))
+#define ColdStreamOfBufChunk(chunk)     (LOG_BLK_PER_BANK - 1 - ChunkToLbn(chunk))
 //#define ColdLogBufLpn       (HotLogBufLpn + 1)
 #define ColdLogBufBitFlag   (1 << 31)
 #define StartOwLogLpn       (1 << 31)
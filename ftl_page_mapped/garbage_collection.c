@@ -6,6 +6,9 @@
 #include "heap.h"
 #include "cleanList.h"
 #include "write.h"
+#include "chunksMap.h"
+#include "sectorOverlay.h"
+#include "read.h" // rebuildPageToFtlBuf
 
 #include <stdio.h>
 
@@ -27,6 +30,20 @@ UINT32 victimVbn[NUM_BANKS];
 UINT8 pageOffset[NUM_BANKS];
 UINT8 gcOnRecycledPage[NUM_BANKS];
 
+/* Preemption point between two GC page moves: serve the host reads waiting in the SATA event queue.
+ * At most gcPreemptReadsPerStep reads are served per page move, so that GC always progresses, and at
+ * most gcPreemptMaxReads per garbageCollectLog call: after that GC runs to completion without
+ * interruptions, so that a read-heavy workload cannot starve the reclamation of clean blocks. */
+static void serveReadsBetweenGcSteps(UINT32 * readsServed)
+{
+#if OPTION_READ_PREEMPT_GC
+    if (*readsServed < gcPreemptMaxReads)
+    {
+        *readsServed += sata_serve_pending_reads(MIN(gcPreemptReadsPerStep, gcPreemptMaxReads - *readsServed));
+    }
+#endif
+}
+
 void finishGC()
 {
     while(1)
@@ -134,6 +151,7 @@ void garbageCollectLog(const UINT32 bank_)
     //UINT32 lastBank = firstBank + 1;
 
     UINT32 banks[NUM_CHANNELS];
+    UINT32 readsServed = 0;
 
     for (UINT32 i=0; i<NUM_CHANNELS; ++i)
     {
@@ -148,7 +166,7 @@ void garbageCollectLog(const UINT32 bank_)
 #if PrintStats
         uart_print_level_1("i="); uart_print_level_1_int(i);
 #endif
-        if ((bank_ % NUM_CHANNELS) == i)
+        if (BankToChannel(bank_) == i)
         {
 #if PrintStats
             uart_print_level_1(" bank_ = "); uart_print_level_1_int(bank_); uart_print_level_1("; ");
@@ -157,9 +175,10 @@ void garbageCollectLog(const UINT32 bank_)
         }
         else
         {
-            UINT32 bank = (bank_/NUM_CHANNELS)*NUM_CHANNELS + i;
-            for (UINT32 column=bank_/NUM_CHANNELS; column < NUM_BANKS/NUM_CHANNELS; ++column)
+            // one bank per channel, starting from the way of bank_, so that the copies of all the channels proceed in parallel
+            for (UINT32 way=bankWay[bank_]; way < WAYS_PER_CHANNEL; ++way)
             {
+                UINT32 bank = channelBank[i][way];
 #if PrintStats
                 uart_print_level_1(" try bank = "); uart_print_level_1_int(bank);
 #endif
@@ -173,7 +192,6 @@ void garbageCollectLog(const UINT32 bank_)
 #if PrintStats
                     uart_print_level_1(" cl = "); uart_print_level_1_int(cleanListSize(&cleanListDataWrite, bank));
 #endif
-                    bank = (bank + NUM_CHANNELS) % NUM_BANKS;
                 }
             }
 #if PrintStats
@@ -262,6 +280,7 @@ void garbageCollectLog(const UINT32 bank_)
                         //UINT32 timerValue=GET_TIMER_VALUE(TIMER_CH2);
                         //UINT32 nTicks = 0xFFFFFFFF - timerValue;
                         //uart_print_level_1("r "); uart_print_level_1_int(nTicks); uart_print_level_1("\r\n");
+                        serveReadsBetweenGcSteps(&readsServed);
                         break;
                     }
 
@@ -273,6 +292,7 @@ void garbageCollectLog(const UINT32 bank_)
                         //UINT32 timerValue=GET_TIMER_VALUE(TIMER_CH2);
                         //UINT32 nTicks = 0xFFFFFFFF - timerValue;
                         //uart_print_level_1("w "); uart_print_level_1_int(nTicks); uart_print_level_1("\r\n");
+                        serveReadsBetweenGcSteps(&readsServed);
                         break;
                     }
 
@@ -292,9 +312,43 @@ void garbageCollectLog(const UINT32 bank_)
 //UINT32 bankForBGCleaning=0;
 
 UINT32 bgCleaningColumn=0;
-
-void backgroundCleaning(const UINT32 bank_)
+static UINT32 bgCleaningBank = NUM_BANKS - 1;
+
+/* One bounded slice of GC, for the time spent waiting for the host.
+ * Moves one page of a GC left in progress by garbageCollectLog, on an idle bank. New GCs are not started
+ * here, and bank_ is skipped since the host write is about to use it. A page is written only if the GC stream
+ * has room for it, otherwise flushing the stream could open a new block and run a foreground GC.
+ * Returns TRUE if some work was done. */
+BOOL8 backgroundCleaning(const UINT32 bank_)
 {
+    for (UINT32 i=1; i<=NUM_BANKS; ++i)
+    {
+        UINT32 bank = (bgCleaningBank + i) % NUM_BANKS;
+        if (bank == bank_ || gcState[bank] == GcIdle || isBankBusy(bank))
+        {
+            continue;
+        }
+        if (gcState[bank] == GcWrite)
+        { // a complete page is programmed directly, but goes through the log buffer if one of its chunks was moved meanwhile
+            UINT32 nChunks = (nValidChunksInPage[bank] == CHUNKS_PER_PAGE) ? CHUNKS_PER_PAGE - 1 : nValidChunksInPage[bank];
+            if (gcLogHasRoom(bank, nChunks) == FALSE)
+            {
+                continue;
+            }
+        }
+        uart_print("backgroundCleaning bank "); uart_print_int(bank); uart_print("\r\n");
+        bgCleaningBank = bank;
+        if (gcState[bank] == GcRead)
+        {
+            readPage(bank);
+        }
+        else
+        {
+            writePage(bank);
+        }
+        return TRUE;
+    }
+    return FALSE;
 }
 
 /*
@@ -424,6 +478,18 @@ void initGC(UINT32 bank)
 
     victimVbn[bank] = get_log_vbn(bank, victimLbn[bank]);
 
+#if OPTION_COLD_REUSE
+    coldReuseVictimFeedback(bank, victimLbn[bank], nValidChunksFromHeap[bank]); // before the victim enters the adaptive window
+#endif
+
+#if OPTION_LOG_STREAMS
+    { // the valid chunks of the victim survived one more GC: they move to the next older cold stream
+        UINT32 victimStream = read_dram_8(LogBlkStream(bank, victimLbn[bank]));
+        gcStream[bank] = (victimStream + 1 < NUM_COLD_STREAMS) ? victimStream + 1 : NUM_COLD_STREAMS - 1;
+        uart_print("GC stream "); uart_print_int(gcStream[bank]); uart_print("\r\n");
+    }
+#endif
+
     uart_print("initGC, bank "); uart_print_int(bank);
     uart_print(" victimLbn "); uart_print_int(victimLbn[bank]);
     uart_print(" valid chunks "); uart_print_int(nValidChunksFromHeap[bank]); uart_print("\r\n");
@@ -441,6 +507,9 @@ void initGC(UINT32 bank)
 #endif
 
     { // Insert new value at position 0 in adaptive window and shift all others
+#if OPTION_FIXED_POINT_REUSE || OPTION_COLD_REUSE
+        adaptiveWindowSum[bank] = adaptiveWindowSum[bank] - adaptiveWindow[bank][adaptiveWindowSize-1] + nValidChunksFromHeap[bank];
+#endif
         for (int i=adaptiveWindowSize-1; i>0; --i)
         {
             adaptiveWindow[bank][i] = adaptiveWindow[bank][i-1];
@@ -463,6 +532,9 @@ void initGC(UINT32 bank)
         resetValidChunksAndRemove(&heapDataCold, bank, victimLbn[bank], CHUNKS_PER_LOG_BLK_SECOND_USAGE);
         nand_block_erase(bank, victimVbn[bank]);
         cleanListPush(&cleanListDataWrite, bank, victimLbn[bank]);
+#if OPTION_PAGE_VALID_SUMMARY
+        resetBlkValidSummary(bank, victimLbn[bank]);
+#endif
 
 #if MeasureGc
         uart_print_level_2("GCW "); uart_print_level_2_int(bank);
@@ -478,6 +550,8 @@ void initGC(UINT32 bank)
 
 void checkNoChunksAreValid(UINT32 bank, UINT32 lbn)
 {
+#if OPTION_DEMAND_PAGED_MAP == 0 && OPTION_COMPRESSED_MAP == 0 // needs the whole map table in DRAM
+    chunksMapWriteBack();
     for(UINT32 page=0; page<PAGES_PER_BLK; ++page)
     {
         for (UINT32 chunk=0; chunk<CHUNKS_PER_PAGE; ++chunk)
@@ -497,13 +571,14 @@ void checkNoChunksAreValid(UINT32 bank, UINT32 lbn)
                 uart_print_level_1(". dataLpn=");
                 uart_print_level_1_int(i/CHUNKS_PER_PAGE);
                 uart_print_level_1("\r\n");
-                if (read_dram_32(ChunksMapTable(i/CHUNKS_PER_PAGE, i%CHUNKS_PER_PAGE)) != logChunkAddr )
+                if (getChunkAddr(i/CHUNKS_PER_PAGE, i%CHUNKS_PER_PAGE) != logChunkAddr )
                 {
                     uart_print_level_1("Nevermind\r\n");
                 }
             }
         }
     }
+#endif
 }
 
 void readPage(UINT32 bank)
@@ -552,7 +627,7 @@ void readPage(UINT32 bank)
                 UINT32 victimLpn = victimLpns[chunkOffset];
                 if (victimLpn != INVALID)
                 {
-                    UINT32 i = mem_search_equ_dram_4_bytes(ChunksMapTable(victimLpn, 0), CHUNKS_PER_PAGE, logChunkAddr);
+                    UINT32 i = findChunkIdx(victimLpn, logChunkAddr);
 
                     if(i<CHUNKS_PER_PAGE)
                     {
@@ -587,7 +662,7 @@ void readPage(UINT32 bank)
                 UINT32 victimLpn = victimLpns[chunkOffset];
                 if (victimLpn != INVALID)
                 {
-                    UINT32 i = mem_search_equ_dram_4_bytes(ChunksMapTable(victimLpn, 0), CHUNKS_PER_PAGE, logChunkAddr);
+                    UINT32 i = findChunkIdx(victimLpn, logChunkAddr);
 
                     if(i<CHUNKS_PER_PAGE)
                     {
@@ -652,6 +727,9 @@ void readPage(UINT32 bank)
     resetValidChunksAndRemove(&heapDataCold, bank, victimLbn[bank], CHUNKS_PER_LOG_BLK_SECOND_USAGE);
     nand_block_erase(bank, victimVbn[bank]);
     cleanListPush(&cleanListDataWrite, bank, victimLbn[bank]);
+#if OPTION_PAGE_VALID_SUMMARY
+    resetBlkValidSummary(bank, victimLbn[bank]);
+#endif
 
     uart_print("After GC: victim lbn was "); uart_print_int(victimLbn[bank]); uart_print("\r\n");
 
@@ -686,6 +764,9 @@ void readPageSingleStep(UINT32 bank)
         resetValidChunksAndRemove(&heapDataCold, bank, victimLbn[bank], CHUNKS_PER_LOG_BLK_SECOND_USAGE);
         nand_block_erase(bank, victimVbn[bank]);
         cleanListPush(&cleanListDataWrite, bank, victimLbn[bank]);
+#if OPTION_PAGE_VALID_SUMMARY
+        resetBlkValidSummary(bank, victimLbn[bank]);
+#endif
 #if MeasureGc
         uart_print_level_2("GCW "); uart_print_level_2_int(bank);
         uart_print_level_2(" "); uart_print_level_2_int(0);
@@ -732,7 +813,7 @@ void readPageSingleStep(UINT32 bank)
             UINT32 victimLpn = victimLpns[chunkOffset];
             if (victimLpn != INVALID)
             {
-                UINT32 i = mem_search_equ_dram_4_bytes(ChunksMapTable(victimLpn, 0), CHUNKS_PER_PAGE, logChunkAddr);
+                UINT32 i = findChunkIdx(victimLpn, logChunkAddr);
 
                 if(i<CHUNKS_PER_PAGE)
                 {
@@ -755,7 +836,7 @@ void readPageSingleStep(UINT32 bank)
             UINT32 victimLpn = victimLpns[chunkOffset];
             if (victimLpn != INVALID)
             {
-                UINT32 i = mem_search_equ_dram_4_bytes(ChunksMapTable(victimLpn, 0), CHUNKS_PER_PAGE, logChunkAddr);
+                UINT32 i = findChunkIdx(victimLpn, logChunkAddr);
 
                 if(i<CHUNKS_PER_PAGE)
                 {
@@ -786,13 +867,59 @@ void readPageSingleStep(UINT32 bank)
 
 }
 
+#if OPTION_COMPRESSED_MAP
+/* Rewrites a lpn whose chunks are scattered as one contiguous page of the GC stream, which releases its chunk map
+ * slot. The page is rebuilt in FTL_BUF in GcMode, which invalidates the old chunks, and chunks that were invalid
+ * are written as erased data. The program completes before increaseLpn, which may start a GC that serves reads. */
+static void consolidatePage(const UINT32 dataLpn)
+{
+    UINT32 bank = dataLpn % NUM_BANKS;
+    uart_print("consolidatePage: lpn "); uart_print_int(dataLpn); uart_print(" on bank "); uart_print_int(bank); uart_print("\r\n");
+    rebuildPageToFtlBuf(dataLpn, 0, SECTORS_PER_PAGE, GcMode);
+
+    LogCtrlBlock * gcCtrl = gcLogCtrl(bank);
+    UINT32 dstLpn = getRWLpn(bank, gcCtrl);
+    UINT32 dstPageOffset = LogPageToOffset(dstLpn);
+#if OPTION_LOG_STREAMS
+    write_dram_8(LogBlkStream(bank, LogPageToLogBlk(dstLpn)), gcCtrl[bank].stream);
+#endif
+    nand_page_program(bank, get_log_vbn(bank, LogPageToLogBlk(dstLpn)), dstPageOffset, FTL_BUF(0), RETURN_WHEN_DONE);
+
+    UINT32 chunkAddrs[CHUNKS_PER_PAGE];
+    for (UINT32 chunkOffset=0; chunkOffset<CHUNKS_PER_PAGE; chunkOffset++)
+    {
+        write_dram_32(chunkInLpnsList(gcCtrl[bank].lpnsListAddr, dstPageOffset, chunkOffset), dataLpn);
+        chunkAddrs[chunkOffset] = (bank * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + (dstLpn * CHUNKS_PER_PAGE) + chunkOffset;
+    }
+    setPageChunkAddrs(dataLpn, chunkAddrs);
+    chunksMapWriteBack(); // cached map lines release their slots only when written back
+
+    gcCtrl[bank].increaseLpn(bank, gcCtrl);
+}
+
+// Called before every chunk written by the host: one page is consolidated below twice the reserve, as many as needed below it.
+void consolidateFragmentedPages()
+{
+    UINT32 dataLpn = chunksMapFragmentedLpn(2 * CHUNK_MAP_RESERVED_SLOTS);
+    if (dataLpn == INVALID)
+    {
+        return;
+    }
+    consolidatePage(dataLpn);
+    while ((dataLpn = chunksMapFragmentedLpn(CHUNK_MAP_RESERVED_SLOTS)) != INVALID)
+    {
+        consolidatePage(dataLpn);
+    }
+}
+#endif
+
 void writePage(UINT32 bank)
 {
     uart_print("writePage: bank="); uart_print_int(bank);
     uart_print(" victimLbn "); uart_print_int(victimLbn[bank]);
     uart_print(" pageOffset "); uart_print_int(pageOffset[bank]); uart_print(" ");
 
-    if(nValidChunksInPage[bank] == 8)
+    if(nValidChunksInPage[bank] == CHUNKS_PER_PAGE)
     {
 
         UINT32 logChunkBase = ((bank*LOG_BLK_PER_BANK*CHUNKS_PER_BLK) + (victimLbn[bank]*CHUNKS_PER_BLK) + (pageOffset[bank]*CHUNKS_PER_PAGE));
@@ -803,9 +930,9 @@ void writePage(UINT32 bank)
 
         for(UINT32 chunkOffset=0; chunkOffset<CHUNKS_PER_PAGE; chunkOffset++)
         {
-            UINT32 chunkAddr = read_dram_32(ChunksMapTable(dataLpns[bank][chunkOffset], dataChunkOffsets[bank][chunkOffset]));
+            UINT32 chunkAddr = getChunkAddr(dataLpns[bank][chunkOffset], dataChunkOffsets[bank][chunkOffset]);
 
-            // note (fabio): here we check against the normal chunkAddr (not recycled) because if there are 8 valid chunks the blk cannot be a recycled one
+            // note (fabio): here we check against the normal chunkAddr (not recycled) because if all the chunks of the page are valid the blk cannot be a recycled one
             if(chunkAddr != logChunkBase + chunkOffset)
             {
                 // note(fabio): here invalidate only the first chunk that was moved by another write. If other chunks were also moved they'll be found by the code after the goto
@@ -817,7 +944,8 @@ void writePage(UINT32 bank)
 
         }
 
-        UINT32 dstLpn = getRWLpn(bank, coldLogCtrl);
+        LogCtrlBlock * gcCtrl = gcLogCtrl(bank);
+        UINT32 dstLpn = getRWLpn(bank, gcCtrl);
         UINT32 dstVbn = get_log_vbn(bank, LogPageToLogBlk(dstLpn));
         UINT32 dstPageOffset = LogPageToOffset(dstLpn);
 
@@ -828,13 +956,31 @@ void writePage(UINT32 bank)
         uart_print_level_1("^\r\n");
 #endif
 
+#if OPTION_SECTOR_OVERLAY
+        BOOL8 gcBufReady = FALSE;
+        for (UINT32 chunkOffset=0; chunkOffset<CHUNKS_PER_PAGE; ++chunkOffset)
+        {
+            if (sectorOverlayHasLpn(dataLpns[bank][chunkOffset]))
+            {
+                if (gcBufReady == FALSE)
+                {
+                    waitBusyBank(bank); // GC_BUF is read with RETURN_ON_ISSUE
+                    gcBufReady = TRUE;
+                }
+                sectorOverlayMergeInto(dataLpns[bank][chunkOffset], dataChunkOffsets[bank][chunkOffset], GC_BUF(bank) + (chunkOffset * BYTES_PER_CHUNK));
+            }
+        }
+#endif
+#if OPTION_LOG_STREAMS
+        write_dram_8(LogBlkStream(bank, LogPageToLogBlk(dstLpn)), gcCtrl[bank].stream);
+#endif
         nand_page_program(bank, dstVbn, dstPageOffset, GC_BUF(bank), RETURN_ON_ISSUE);
 
-        mem_copy(chunkInLpnsList(coldLogCtrl[bank].lpnsListAddr, dstPageOffset, 0), dataLpns[bank], CHUNKS_PER_PAGE * sizeof(UINT32));
+        mem_copy(chunkInLpnsList(gcCtrl[bank].lpnsListAddr, dstPageOffset, 0), dataLpns[bank], CHUNKS_PER_PAGE * sizeof(UINT32));
 
         for (UINT32 chunkOffset=0; chunkOffset<CHUNKS_PER_PAGE; ++chunkOffset)
         {
-            write_dram_32(ChunksMapTable(dataLpns[bank][chunkOffset], dataChunkOffsets[bank][chunkOffset]), (bank * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + (dstLpn * CHUNKS_PER_PAGE) + chunkOffset);
+            setChunkAddr(dataLpns[bank][chunkOffset], dataChunkOffsets[bank][chunkOffset], (bank * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + (dstLpn * CHUNKS_PER_PAGE) + chunkOffset);
         }
 
         nValidChunksInPage[bank] = 0;
@@ -844,7 +990,7 @@ void writePage(UINT32 bank)
 
         pageOffset[bank]++;
 
-        coldLogCtrl[bank].increaseLpn(bank, coldLogCtrl);
+        gcCtrl[bank].increaseLpn(bank, gcCtrl);
 
     }
     else
@@ -866,7 +1012,7 @@ WritePartialPage:
                 validChunks[bank][chunkOffset] = FALSE;
                 nValidChunksInPage[bank]--;
 
-                UINT32 chunkAddr = read_dram_32(ChunksMapTable(dataLpns[bank][chunkOffset], dataChunkOffsets[bank][chunkOffset]));
+                UINT32 chunkAddr = getChunkAddr(dataLpns[bank][chunkOffset], dataChunkOffsets[bank][chunkOffset]);
 
                 if(chunkAddr == logChunkBase+chunkOffset)
                 {
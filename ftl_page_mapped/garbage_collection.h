@@ -10,6 +10,9 @@ void finishGC();
 
 void progressiveMerge(const UINT32 bank, const UINT32 maxFlashOps);
 void garbageCollectLog(const UINT32 bank);
-void backgroundCleaning(const UINT32 bank);
+BOOL8 backgroundCleaning(const UINT32 bank);
+#if OPTION_COMPRESSED_MAP
+void consolidateFragmentedPages();
+#endif
 //#define backgroundCleaning(X)
 #endif
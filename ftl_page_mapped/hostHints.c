@@ -0,0 +1,86 @@
+#include "hostHints.h"
+#include "ftl_parameters.h"
+
+/* Temperature hints given by the host for ranges of lbas.
+ * The host tags a range with the vendor-specific ATA_SET_HOST_HINT command, e.g. a storage engine tagging its logs as
+ * hot and its sorted tables as cold, and the writes that start in the range bypass the temperature detection and go to
+ * ftl_write_hot or ftl_write_cold.
+ * The ranges are kept in a small ring, the most recent first: a newer range overrides the older ones it overlaps, and
+ * a range tagged HostHintNone gives its lbas back to the detector. The oldest range is dropped when the ring is full. */
+
+#if OPTION_HOST_HINTS
+
+static UINT32 hintLba[NUM_HOST_HINT_RANGES];
+static UINT32 hintSects[NUM_HOST_HINT_RANGES];
+static UINT8 hintKind[NUM_HOST_HINT_RANGES];
+static UINT32 nHints;
+static UINT32 newestHint;
+
+#define HintSlot(age)       ((newestHint + NUM_HOST_HINT_RANGES - (age)) % NUM_HOST_HINT_RANGES)
+
+void hostHintsInit()
+{
+    uart_print("hostHintsInit: ranges = "); uart_print_int(NUM_HOST_HINT_RANGES); uart_print("\r\n");
+    nHints = 0;
+    newestHint = NUM_HOST_HINT_RANGES - 1;
+}
+
+// Returns FALSE if the hint kind is unknown.
+BOOL8 hostHintsSet(const UINT32 lba, const UINT32 nSects, const UINT32 hint)
+{
+    uart_print("hostHintsSet: lba="); uart_print_int(lba); uart_print(" num_sectors="); uart_print_int(nSects);
+    uart_print(" hint="); uart_print_int(hint); uart_print("\r\n");
+    if (hint == HostHintClearAll)
+    {
+        nHints = 0;
+        return TRUE;
+    }
+    if (hint != HostHintNone && hint != HostHintHot && hint != HostHintCold)
+    {
+        return FALSE;
+    }
+
+    // Ranges completely covered by the new one will never be looked up again, compact them away.
+    UINT32 oldest = HintSlot(nHints - 1);
+    UINT32 kept = 0;
+    for (UINT32 i=0; i<nHints; i++)
+    {
+        UINT32 src = (oldest + i) % NUM_HOST_HINT_RANGES;
+        if (hintLba[src] >= lba && hintLba[src] + hintSects[src] <= lba + nSects)
+        {
+            continue;
+        }
+        UINT32 dst = (oldest + kept) % NUM_HOST_HINT_RANGES;
+        hintLba[dst] = hintLba[src];
+        hintSects[dst] = hintSects[src];
+        hintKind[dst] = hintKind[src];
+        kept++;
+    }
+    newestHint = (oldest + kept + NUM_HOST_HINT_RANGES - 1) % NUM_HOST_HINT_RANGES;
+    nHints = kept;
+
+    newestHint = (newestHint + 1) % NUM_HOST_HINT_RANGES;
+    hintLba[newestHint] = lba;
+    hintSects[newestHint] = nSects;
+    hintKind[newestHint] = hint;
+    if (nHints < NUM_HOST_HINT_RANGES)
+    {
+        nHints++;
+    }
+    return TRUE;
+}
+
+UINT32 hostHintOf(const UINT32 lba)
+{
+    for (UINT32 age=0; age<nHints; age++)
+    {
+        UINT32 slot = HintSlot(age);
+        if (lba >= hintLba[slot] && lba < hintLba[slot] + hintSects[slot])
+        {
+            return hintKind[slot];
+        }
+    }
+    return HostHintNone;
+}
+
+#endif
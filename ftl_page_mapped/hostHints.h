@@ -0,0 +1,15 @@
+#ifndef HOST_HINTS_H
+#define HOST_HINTS_H
+#include "jasmine.h"
+
+// Hint kinds, as sent by the host in the features register of ATA_SET_HOST_HINT
+#define HostHintNone        0x00
+#define HostHintHot         0x01
+#define HostHintCold        0x02
+#define HostHintClearAll    0xFF
+
+void hostHintsInit();
+BOOL8 hostHintsSet(const UINT32 lba, const UINT32 nSects, const UINT32 hint);
+UINT32 hostHintOf(const UINT32 lba);
+
+#endif
@@ -7,6 +7,7 @@
 #include "cleanList.h"
 #include "flash.h" // Flash operations and flags
 #include "write.h" // updateChunkPtr functions
+#include "chunksMap.h" // findChunkIdx
 
 #define Write_log_bmt(bank, lbn, vblock) write_dram_16 (LOG_BMT_ADDR + ((bank * LOG_BLK_PER_BANK + lbn) * sizeof (UINT16)), vblock)
 #define Read_log_bmt(bank, lbn) read_dram_16 (LOG_BMT_ADDR + ((bank * LOG_BLK_PER_BANK + lbn) * sizeof (UINT16)))
@@ -21,6 +22,19 @@ static BOOL8 reuseCondition(UINT32 bank);
 #if AlwaysReuse
 static BOOL8 reuseConditionHot(UINT32 bank);
 #endif
+#if OPTION_ASYNC_RELOCATION
+static void initResidualRelocation();
+#endif
+#if OPTION_COLD_REUSE
+static void initColdReuse();
+#endif
+#if OPTION_PRECACHE_RING
+static void resetPrecacheRing(const UINT32 bank, const UINT32 firstPageOffset);
+static UINT32 precacheTailSlot(const UINT32 bank);
+static BOOL8 isPrecacheSlotRead(const UINT32 bank, const UINT32 slot);
+static void readPrecacheSlot(const UINT32 bank, const UINT32 slot, LogCtrlBlock * ctrlBlock);
+#endif
+static BOOL8 testLowPageForReuse(const UINT32 bank, const UINT32 pageOffset, LogCtrlBlock * ctrlBlock);
 
 // set log vbn to log block mapping table
 void set_log_vbn (UINT32 const bank, UINT32 const log_lbn, UINT32 const vblock)
@@ -58,12 +72,38 @@ void initLog()
 
     //int off = __builtin_offsetof(LogCtrlBlock, increaseLpn);
 
+#if OPTION_FIXED_POINT_REUSE || OPTION_COLD_REUSE
+    adaptiveWindowRecip = (65536 + adaptiveWindowSize / 2) / adaptiveWindowSize;
+#endif
+#if OPTION_ASYNC_RELOCATION
+    initResidualRelocation();
+#endif
+#if OPTION_COLD_REUSE
+    initColdReuse();
+#endif
     for(int bank=0; bank<NUM_BANKS; bank++)
     {
         adaptiveStepDown[bank] = initStepDown;
+#if OPTION_PRECACHE_RING
+        resetPrecacheRing(bank, INVALID);
+#endif
         adaptiveStepUp[bank] = initStepUp;
         nStepUps[bank] = 0;
         nStepDowns[bank] = 0;
+#if OPTION_FIXED_POINT_REUSE || OPTION_COLD_REUSE
+        adaptiveWindowSum[bank] = 0;
+        for (int i=0; i<adaptiveWindowSize; ++i)
+        {
+            adaptiveWindowSum[bank] += adaptiveWindow[bank][i];
+        }
+#endif
+#if OPTION_FIXED_POINT_REUSE
+        hotFirstAccumulatedFx[bank] = hotFirstAccumulated[bank] << ReuseFxShift;
+        reuseCtrlUpdates[bank] = 0;
+        reuseCtrlAbsErr[bank] = 0;
+        reuseCtrlSignChanges[bank] = 0;
+        reuseCtrlLastUp[bank] = FALSE;
+#endif
 
         for(int lbn=0; lbn<LOG_BLK_PER_BANK; lbn++)
         {
@@ -84,6 +124,7 @@ void initLog()
             .allChunksInLogAreValid = TRUE,
             .useRecycledPage=FALSE,
             .precacheDone=TRUE,
+            .stream=0,
         };
 
         for(int chunk=0; chunk<CHUNKS_PER_PAGE; ++chunk)
@@ -92,31 +133,133 @@ void initLog()
             hotLogCtrl[bank].chunkIdx[chunk] = INVALID;
         }
 
-        lbn = cleanListPop(&cleanListDataWrite, bank);
-
-        coldLogCtrl[bank] = (LogCtrlBlock)
+        for(UINT32 stream=0; stream<NUM_COLD_STREAMS; ++stream)
         {
-            .logLpn = lbn * PAGES_PER_BLK,
-            .lpnsListAddr = LPNS_BUF_BASE_2(bank),
-            .logBufferAddr = COLD_LOG_BUF(bank),
-            .chunkPtr = 0,
-            .increaseLpn=increaseLpnColdBlk,
-            .updateChunkPtr=updateChunkPtr,
-            .nextLowPageOffset=INVALID,
-            .allChunksInLogAreValid = TRUE,
-            .useRecycledPage=FALSE,
-            .precacheDone=TRUE,
-        };
-        for(int chunk=0; chunk<CHUNKS_PER_PAGE; ++chunk)
-        {
-            coldLogCtrl[bank].dataLpn[chunk] = INVALID;
-            coldLogCtrl[bank].chunkIdx[chunk] = INVALID;
+            lbn = cleanListPop(&cleanListDataWrite, bank);
+
+            coldStreamCtrl[stream][bank] = (LogCtrlBlock)
+            {
+                .logLpn = lbn * PAGES_PER_BLK,
+                .lpnsListAddr = COLD_STREAM_LPNS_BUF(stream, bank),
+                .logBufferAddr = COLD_STREAM_LOG_BUF(stream, bank),
+                .chunkPtr = 0,
+                .increaseLpn=increaseLpnColdBlk,
+                .updateChunkPtr=updateChunkPtr,
+                .nextLowPageOffset=INVALID,
+                .allChunksInLogAreValid = TRUE,
+                .useRecycledPage=FALSE,
+                .precacheDone=TRUE,
+                .stream=stream,
+            };
+            for(int chunk=0; chunk<CHUNKS_PER_PAGE; ++chunk)
+            {
+                coldStreamCtrl[stream][bank].dataLpn[chunk] = INVALID;
+                coldStreamCtrl[stream][bank].chunkIdx[chunk] = INVALID;
+            }
         }
+        gcStream[bank] = (NUM_COLD_STREAMS > 1) ? 1 : 0;
 
         nValidChunksFromHeap[bank] = INVALID;
     }
 }
 
+#if OPTION_COLD_REUSE
+/* Reuse of first usage hot blocks by the cold streams.
+ * A cold stream programs only the high pages of the block, so the valid chunks of the low pages stay where they are:
+ * the block is taken only if there are at most coldReuseMaxValid[bank] of them. Cold data is invalidated much later
+ * than hot data, so the bound has its own controller, fed by the cold reused blocks themselves when GC picks them.
+ * A victim with fewer valid chunks than the recent GC victims (adaptiveWindow) means reuse was cheap and the bound goes
+ * up, otherwise it goes down, by a step proportional to the difference. The bound replaces reuseCondition only when the
+ * clean list is short: clean blocks are still taken first. */
+static UINT32 coldReusedBlk[NUM_BANKS][(LOG_BLK_PER_BANK + 31) / 32]; // bitmap of the blocks whose high pages were written by a cold stream
+
+static void initColdReuse()
+{
+    mem_set_sram(coldReusedBlk, 0, sizeof(coldReusedBlk));
+    for (UINT32 bank=0; bank<NUM_BANKS; bank++)
+    {
+        coldReuseMaxValid[bank] = coldReuseMaxValidInit;
+        coldReuseBlks[bank] = 0;
+    }
+}
+
+static BOOL8 coldReuseCondition(const UINT32 bank)
+{
+    if (heapDataFirstUsage.nElInHeap[bank] == 0)
+    {
+        return FALSE;
+    }
+    UINT32 nValidChunks = getVictimValidPagesNumber(&heapDataFirstUsage, bank);
+    // The high pages never written in first usage are counted as valid
+    UINT32 nValidLowChunks = (nValidChunks > CHUNKS_PER_OW_LOG_BLK) ? nValidChunks - CHUNKS_PER_OW_LOG_BLK : 0;
+    uart_print("coldReuseCondition bank "); uart_print_int(bank); uart_print(" valid low chunks "); uart_print_int(nValidLowChunks);
+    uart_print(" bound "); uart_print_int(coldReuseMaxValid[bank]); uart_print("\r\n");
+    return (nValidLowChunks <= coldReuseMaxValid[bank]);
+}
+
+void coldReuseVictimFeedback(const UINT32 bank, const UINT32 lbn, const UINT32 nValidChunks)
+{
+    UINT32 mask = (UINT32)1 << (lbn % 32);
+    if ((coldReusedBlk[bank][lbn / 32] & mask) == 0)
+    {
+        return;
+    }
+    coldReusedBlk[bank][lbn / 32] &= ~mask;
+
+    UINT32 avg = AdaptiveWindowAvg(bank, 0); // the window sum is kept by GC
+
+    BOOL8 up = (nValidChunks < avg);
+    UINT32 step = (up ? avg - nValidChunks : nValidChunks - avg) >> coldReuseGainShift;
+    if (step > coldReuseMaxStep)
+    {
+        step = coldReuseMaxStep;
+    }
+    if (up)
+    {
+        coldReuseMaxValid[bank] = (coldReuseMaxValid[bank] + step < coldReuseMaxValidLimit) ? coldReuseMaxValid[bank] + step : coldReuseMaxValidLimit;
+    }
+    else
+    {
+        coldReuseMaxValid[bank] = (coldReuseMaxValid[bank] > step) ? coldReuseMaxValid[bank] - step : 0;
+    }
+
+#if PrintStats
+    uart_print_level_1("CRCTL "); uart_print_level_1_int(bank);
+    uart_print_level_1(" avg "); uart_print_level_1_int(avg);
+    uart_print_level_1(" victim "); uart_print_level_1_int(nValidChunks);
+    uart_print_level_1(" bound "); uart_print_level_1_int(coldReuseMaxValid[bank]);
+    uart_print_level_1(" reused "); uart_print_level_1_int(coldReuseBlks[bank]); uart_print_level_1("\r\n");
+#endif
+}
+#endif
+
+// The cold stream writes the high pages of the first usage hot block with the fewest valid chunks.
+static void reuseFirstUsageBlkForColdLog(const UINT32 bank, LogCtrlBlock * ctrlBlock)
+{
+#if PrintStats
+    uart_print_level_1("REUSECOLD\r\n");
+#endif
+    uart_print(" second usage\r\n");
+    UINT32 lbn = getVictim(&heapDataFirstUsage, bank);
+    UINT32 nValidChunks = getVictimValidPagesNumber(&heapDataFirstUsage, bank);
+    resetValidChunksAndRemove(&heapDataFirstUsage, bank, lbn, CHUNKS_PER_LOG_BLK_FIRST_USAGE);
+    resetValidChunksAndRemove(&heapDataSecondUsage, bank, lbn, CHUNKS_PER_LOG_BLK_SECOND_USAGE);
+    resetValidChunksAndRemove(&heapDataCold, bank, lbn, nValidChunks);
+    ctrlBlock[bank].logLpn = (lbn * PAGES_PER_BLK) + 2;
+    ctrlBlock[bank].increaseLpn = increaseLpnColdBlkReused;
+    nand_page_ptread(bank,
+                     get_log_vbn(bank, lbn),
+                     125,
+                     0,
+                     (CHUNK_ADDR_BYTES * CHUNKS_PER_LOG_BLK + BYTES_PER_SECTOR - 1) / BYTES_PER_SECTOR,
+                     ctrlBlock[bank].lpnsListAddr,
+                     RETURN_WHEN_DONE); // Read the lpns list from the max low page (125) where it was previously written by incrementLpnHotBlkFirstUsage
+#if OPTION_COLD_REUSE
+    coldReusedBlk[bank][lbn / 32] |= (UINT32)1 << (lbn % 32);
+    coldReuseBlks[bank]++;
+#endif
+}
+
 static void findNewLpnForColdLog(const UINT32 bank, LogCtrlBlock * ctrlBlock)
 {
     uart_print("findNewLpnForColdLog bank "); uart_print_int(bank);
@@ -132,27 +275,13 @@ static void findNewLpnForColdLog(const UINT32 bank, LogCtrlBlock * ctrlBlock)
     }
     else
     {
+#if OPTION_COLD_REUSE
+        if (coldReuseCondition(bank))
+#else
         if (reuseCondition(bank))
-        {
-#if PrintStats
-            uart_print_level_1("REUSECOLD\r\n");
 #endif
-            uart_print(" second usage\r\n");
-            UINT32 lbn = getVictim(&heapDataFirstUsage, bank);
-            UINT32 nValidChunks = getVictimValidPagesNumber(&heapDataFirstUsage, bank);
-            resetValidChunksAndRemove(&heapDataFirstUsage, bank, lbn, CHUNKS_PER_LOG_BLK_FIRST_USAGE);
-            resetValidChunksAndRemove(&heapDataSecondUsage, bank, lbn, CHUNKS_PER_LOG_BLK_SECOND_USAGE);
-            resetValidChunksAndRemove(&heapDataCold, bank, lbn, nValidChunks);
-            ctrlBlock[bank].logLpn = (lbn * PAGES_PER_BLK) + 2;
-            ctrlBlock[bank].increaseLpn = increaseLpnColdBlkReused;
-            nand_page_ptread(bank,
-                             get_log_vbn(bank, lbn),
-                             125,
-                             0,
-                             (CHUNK_ADDR_BYTES * CHUNKS_PER_LOG_BLK + BYTES_PER_SECTOR - 1) / BYTES_PER_SECTOR,
-                             ctrlBlock[bank].lpnsListAddr,
-                             RETURN_WHEN_DONE); // Read the lpns list from the max low page (125) where it was previously written by incrementLpnHotBlkFirstUsage
-
+        {
+            reuseFirstUsageBlkForColdLog(bank, ctrlBlock);
         }
         else
         {
@@ -222,7 +351,7 @@ void increaseLpnColdBlk (UINT32 const bank, LogCtrlBlock * ctrlBlock)
         mem_set_dram(ctrlBlock[bank].lpnsListAddr, INVALID, (CHUNKS_PER_BLK * CHUNK_ADDR_BYTES));
         insertBlkInHeap(&heapDataCold, bank, lbn);
 
-#if CanReuseBlksForColdData == 0
+#if CanReuseBlksForColdData == 0 && OPTION_COLD_REUSE == 0
         lbn = cleanListPop(&cleanListDataWrite, bank); // Now the hybrid approach can pop from the cleanList
         ctrlBlock[bank].logLpn = lbn * PAGES_PER_BLK;
 
@@ -266,7 +395,7 @@ void printValidChunksInFirstUsageBlk(const UINT32 bank, const LogCtrlBlock * ctr
             UINT32 victimLpn = victimLpns[chunkOffset];
             if (victimLpn != INVALID)
             {
-                UINT32 i = mem_search_equ_dram_4_bytes(ChunksMapTable(victimLpn, 0), CHUNKS_PER_PAGE, logChunkAddr);
+                UINT32 i = findChunkIdx(victimLpn, logChunkAddr);
 
                 if(i<CHUNKS_PER_PAGE)
                 {
@@ -302,7 +431,7 @@ void printValidChunksInFirstUsageBlk(const UINT32 bank, const LogCtrlBlock * ctr
 #if AlwaysReuse
 static BOOL8 reuseConditionHot(UINT32 bank)
 {
-    if (getVictimValidPagesNumber(&heapDataFirstUsage, bank) == 63*CHUNKS_PER_PAGE)
+    if (getVictimValidPagesNumber(&heapDataFirstUsage, bank) == CHUNKS_PER_OW_LOG_BLK)
     {
 #if PrintStats
         uart_print_level_1("FIRSTHOTEMPTY\r\n");
@@ -310,13 +439,13 @@ static BOOL8 reuseConditionHot(UINT32 bank)
         return TRUE;
     }
 
-    //if (getVictimValidPagesNumber(&heapDataFirstUsage, bank) == 63*CHUNKS_PER_PAGE)
+    //if (getVictimValidPagesNumber(&heapDataFirstUsage, bank) == CHUNKS_PER_OW_LOG_BLK)
     if (heapDataFirstUsage.nElInHeap[bank] > 1)
     {
         UINT32 validPagesSecondUsage = getVictimValidPagesNumber(&heapDataSecondUsage, bank);
         UINT32 validPagesCold = getVictimValidPagesNumber(&heapDataCold, bank);
         UINT32 validPagesMin = (validPagesCold < validPagesSecondUsage) ? validPagesCold : validPagesSecondUsage;
-        if ( (getVictimValidPagesNumber(&heapDataFirstUsage, bank) - 63*CHUNKS_PER_PAGE) < validPagesMin)
+        if ( (getVictimValidPagesNumber(&heapDataFirstUsage, bank) - CHUNKS_PER_OW_LOG_BLK) < validPagesMin)
         { return TRUE; }
         else
         { return FALSE; }
@@ -327,16 +456,72 @@ static BOOL8 reuseConditionHot(UINT32 bank)
 #endif
 
 
+#if OPTION_FIXED_POINT_REUSE
+/* Proportional controller of the number of hot blocks accumulated before one is reused (hotFirstAccumulated).
+ * The error is the average of the adaptive window (valid chunks of the last GC victims) minus validMin (valid chunks
+ * of the cheapest block that is not a first usage hot block). A positive error means reusing gives worse victims than
+ * GC had recently, so the threshold goes up, and the other way round. The step is proportional to the error and the
+ * threshold keeps ReuseFxShift fractional bits, so that small errors accumulate instead of being lost.
+ * Everything is integer: the window sum is kept by GC and the division by the window size is a multiplication. */
+static void reuseControllerUpdate(const UINT32 bank, const UINT32 validMin)
+{
+    UINT32 avgFx = AdaptiveWindowAvg(bank, ReuseFxShift);
+    UINT32 validMinFx = validMin << ReuseFxShift;
+    BOOL8 up = (validMinFx < avgFx);
+    UINT32 absErrFx = up ? avgFx - validMinFx : validMinFx - avgFx;
+
+    UINT32 stepFx = (absErrFx * reuseGainNum) >> reuseGainShift;
+    if (stepFx > (reuseMaxStep << ReuseFxShift))
+    {
+        stepFx = reuseMaxStep << ReuseFxShift;
+    }
+
+    UINT32 minFx = reuseThresholdMin << ReuseFxShift;
+    UINT32 maxFx = reuseThresholdMax << ReuseFxShift;
+    if (up)
+    {
+        hotFirstAccumulatedFx[bank] = (hotFirstAccumulatedFx[bank] + stepFx < maxFx) ? hotFirstAccumulatedFx[bank] + stepFx : maxFx;
+    }
+    else
+    {
+        hotFirstAccumulatedFx[bank] = (hotFirstAccumulatedFx[bank] > minFx + stepFx) ? hotFirstAccumulatedFx[bank] - stepFx : minFx;
+    }
+    hotFirstAccumulated[bank] = hotFirstAccumulatedFx[bank] >> ReuseFxShift;
+
+    reuseCtrlUpdates[bank]++;
+    reuseCtrlAbsErr[bank] = reuseCtrlAbsErr[bank] - (reuseCtrlAbsErr[bank] >> 3) + (absErrFx >> 3);
+    if (stepFx != 0)
+    {
+        if (up != reuseCtrlLastUp[bank])
+        {
+            reuseCtrlSignChanges[bank]++;
+        }
+        reuseCtrlLastUp[bank] = up;
+    }
+
+#if PrintStats
+    uart_print_level_1("RCTL "); uart_print_level_1_int(bank);
+    uart_print_level_1(" avg "); uart_print_level_1_int(avgFx >> ReuseFxShift);
+    uart_print_level_1(" validMin "); uart_print_level_1_int(validMin);
+    uart_print_level_1(" step "); uart_print_level_1(up ? "+" : "-"); uart_print_level_1_int(stepFx);
+    uart_print_level_1(" thFx "); uart_print_level_1_int(hotFirstAccumulatedFx[bank]);
+    uart_print_level_1(" absErrFx "); uart_print_level_1_int(reuseCtrlAbsErr[bank]);
+    uart_print_level_1(" flips "); uart_print_level_1_int(reuseCtrlSignChanges[bank]);
+    uart_print_level_1("/"); uart_print_level_1_int(reuseCtrlUpdates[bank]); uart_print_level_1("\r\n");
+#endif
+}
+#endif
+
 static BOOL8 reuseCondition(UINT32 bank)
 {
 #if AlwaysReuse
-    //if (getVictimValidPagesNumber(&heapDataFirstUsage, bank) == 63*CHUNKS_PER_PAGE)
+    //if (getVictimValidPagesNumber(&heapDataFirstUsage, bank) == CHUNKS_PER_OW_LOG_BLK)
     if (heapDataFirstUsage.nElInHeap[bank] > 1)
     {
         UINT32 validPagesSecondUsage = getVictimValidPagesNumber(&heapDataSecondUsage, bank);
         UINT32 validPagesCold = getVictimValidPagesNumber(&heapDataCold, bank);
         UINT32 validPagesMin = (validPagesCold < validPagesSecondUsage) ? validPagesCold : validPagesSecondUsage;
-        if ( (getVictimValidPagesNumber(&heapDataFirstUsage, bank) - 63*CHUNKS_PER_PAGE) < validPagesMin)
+        if ( (getVictimValidPagesNumber(&heapDataFirstUsage, bank) - CHUNKS_PER_OW_LOG_BLK) < validPagesMin)
         { return TRUE; }
         else
         { return FALSE; }
@@ -355,7 +540,7 @@ static BOOL8 reuseCondition(UINT32 bank)
 #endif
 
     //if (getVictimValidPagesNumber(&heapDataFirstUsage, bank) == 62*CHUNKS_PER_PAGE)
-    if (getVictimValidPagesNumber(&heapDataFirstUsage, bank) == 63*CHUNKS_PER_PAGE)
+    if (getVictimValidPagesNumber(&heapDataFirstUsage, bank) == CHUNKS_PER_OW_LOG_BLK)
     {
 #if PrintStats
         uart_print_level_1("FIRSTHOTEMPTY\r\n");
@@ -370,6 +555,9 @@ static BOOL8 reuseCondition(UINT32 bank)
     else
     { validMin = validSecond; }
 
+#if OPTION_FIXED_POINT_REUSE
+    reuseControllerUpdate(bank, validMin);
+#else
     float tot = 0.0;
 #if PrintStats
     uart_print_level_1("AW ");
@@ -456,13 +644,17 @@ static BOOL8 reuseCondition(UINT32 bank)
         }
     }
 
+#endif
+
 #if PrintStats
     uart_print_level_1("HotFirstAccumulated "); uart_print_level_1_int(bank); uart_print_level_1(" "); uart_print_level_1_int(hotFirstAccumulated[bank]); uart_print_level_1("\r\n");
 
     uart_print_level_1("ValidMin=");
     uart_print_level_1_int(validMin);
+#if !OPTION_FIXED_POINT_REUSE
     uart_print_level_1(" tot=");
     uart_print_level_1_int(tot);
+#endif
 #endif
     if (heapDataFirstUsage.nElInHeap[bank] > hotFirstAccumulated[bank])
     //if ((heapDataFirstUsage.nElInHeap[bank] > 0) && ((float)validMin > tot) )
@@ -528,7 +720,10 @@ void findNewLpnForHotLog(const UINT32 bank, LogCtrlBlock * ctrlBlock)
 
             printValidChunksInFirstUsageBlk(bank, ctrlBlock, lbn);
 
-            if (canReuseLowPage(bank, 0, ctrlBlock))
+#if OPTION_PRECACHE_RING
+            resetPrecacheRing(bank, 0);
+#endif
+            if (testLowPageForReuse(bank, 0, ctrlBlock))
             { // Reuse page 0 prefetching immediately
                 precacheLowPage(bank, ctrlBlock);
                 ctrlBlock[bank].updateChunkPtr = updateChunkPtrRecycledPage;
@@ -539,7 +734,7 @@ void findNewLpnForHotLog(const UINT32 bank, LogCtrlBlock * ctrlBlock)
             }
             ctrlBlock[bank].logLpn++;
 
-            if (canReuseLowPage(bank, 1, ctrlBlock))
+            if (testLowPageForReuse(bank, 1, ctrlBlock))
             { // Reuse page 1 prefetching immediately
                 precacheLowPage(bank, ctrlBlock);
                 ctrlBlock[bank].updateChunkPtr = updateChunkPtrRecycledPage;
@@ -581,6 +776,116 @@ void findNewLpnForHotLog(const UINT32 bank, LogCtrlBlock * ctrlBlock)
 }
 
 
+#if OPTION_PAGE_VALID_SUMMARY
+/* Valid-chunk summary of the log pages: one byte per page, with a bit set for every chunk that may still be valid.
+ * An erased block starts with every bit set, and the bits are cleared wherever the valid chunks counters of the heaps
+ * are decremented, so for a first usage hot block the summary is exact and canReuseLowPage can reject a page
+ * without copying its lpns and searching the chunks map. */
+void resetBlkValidSummary(const UINT32 bank, const UINT32 lbn)
+{
+    mem_set_dram(BlkValidSummary(bank, lbn), INVALID, PAGES_PER_BLK * sizeof(UINT8));
+}
+
+void clearChunkValidSummary(const UINT32 chunkAddr)
+{
+    UINT32 realChunkAddr = chunkAddr & ~(ColdLogBufBitFlag);
+    UINT32 summaryAddr = PageValidSummary(realChunkAddr);
+    write_dram_8(summaryAddr, read_dram_8(summaryAddr) & ~((UINT32)1 << (realChunkAddr % CHUNKS_PER_PAGE)));
+}
+#endif
+
+#if OPTION_ASYNC_RELOCATION
+/* Relocation of the residual valid chunks of a low page chosen for reuse.
+ * canReuseLowPage only queues the chunks. They are copied from the precached page to the GC stream of the bank one at
+ * a time by relocateResidualChunkStep, while waiting for the host, and the ones left are relocated by
+ * commitResidualRelocation before the page is reprogrammed. A chunk overwritten or trimmed in the meantime is skipped:
+ * the invalidation was counted on this block, so the count is given back to keep it as if the chunk had been moved. */
+static UINT32 relocPageChunkAddr[NUM_BANKS];                // chunk address of the first chunk of the page, INVALID when nothing is queued
+static UINT32 relocLpn[NUM_BANKS][CHUNKS_PER_PAGE];         // INVALID for the chunks that do not need relocation
+static UINT32 relocChunkIdx[NUM_BANKS][CHUNKS_PER_PAGE];
+#if OPTION_PRECACHE_RING
+static UINT32 relocSlot[NUM_BANKS];                         // slot of the precache ring that holds the page
+#define RelocPageBuf(bank)          PrecacheForEncodingSlot(bank, relocSlot[bank])
+#define IsRelocPageRead(bank)       isPrecacheSlotRead(bank, relocSlot[bank])
+#else
+#define RelocPageBuf(bank)          PrecacheForEncoding(bank)
+#define IsRelocPageRead(bank)       hotLogCtrl[bank].precacheDone
+#endif
+
+static void initResidualRelocation()
+{
+    for (UINT32 bank=0; bank<NUM_BANKS; bank++)
+    {
+        relocPageChunkAddr[bank] = INVALID;
+    }
+}
+
+// Returns FALSE when no chunk of the page is left.
+static BOOL8 relocateOneResidualChunk(const UINT32 bank)
+{
+    for (UINT32 chunkOffset=0; chunkOffset<CHUNKS_PER_PAGE; chunkOffset++)
+    {
+        UINT32 lpn = relocLpn[bank][chunkOffset];
+        if (lpn == INVALID)
+        {
+            continue;
+        }
+        relocLpn[bank][chunkOffset] = INVALID;
+        UINT32 chunkAddr = relocPageChunkAddr[bank] + chunkOffset;
+        if (getChunkAddr(lpn, relocChunkIdx[bank][chunkOffset]) == chunkAddr)
+        {
+            writeChunkOnLogBlockDuringGC(bank, lpn, relocChunkIdx[bank][chunkOffset], chunkOffset, RelocPageBuf(bank));
+        }
+        else
+        {
+            uart_print("relocateOneResidualChunk: lpn "); uart_print_int(lpn); uart_print(" was rewritten\r\n");
+            incrementValidChunksByN(&heapDataSecondUsage, bank, ChunkToLbn(chunkAddr), 1);
+        }
+        return TRUE;
+    }
+    relocPageChunkAddr[bank] = INVALID;
+    return FALSE;
+}
+
+/* One relocation, for the time spent waiting for the host. Only pages already precached on idle banks are served, and
+ * skipBank is left alone since the host write is about to use it. A bank whose GC stream would flush or open a new block
+ * is skipped too, so the host never waits on that work (see gcLogHasRoom). Returns TRUE if some work was done. */
+BOOL8 relocateResidualChunkStep(const UINT32 skipBank)
+{
+    for (UINT32 bank=0; bank<NUM_BANKS; bank++)
+    {
+        if (bank == skipBank || relocPageChunkAddr[bank] == INVALID || IsRelocPageRead(bank) == FALSE || isBankBusy(bank) ||
+            gcLogHasRoom(bank, 1) == FALSE)
+        {
+            continue;
+        }
+        if (relocateOneResidualChunk(bank))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Relocates all the chunks still queued for the bank: the low page can be reprogrammed after this.
+void commitResidualRelocation(const UINT32 bank)
+{
+    if (relocPageChunkAddr[bank] == INVALID)
+    {
+        return;
+    }
+    if (IsRelocPageRead(bank) == FALSE)
+    {
+#if OPTION_PRECACHE_RING
+        readPrecacheSlot(bank, relocSlot[bank], hotLogCtrl);
+#else
+        precacheLowPage(bank, hotLogCtrl);
+#endif
+    }
+    while (relocateOneResidualChunk(bank));
+}
+#endif
+
 BOOL8 canReuseLowPage(const UINT32 bank, const UINT32 pageOffset, LogCtrlBlock * ctrlBlock)
 {
     //uart_print_level_1("canReuseLowPage ");
@@ -591,11 +896,26 @@ BOOL8 canReuseLowPage(const UINT32 bank, const UINT32 pageOffset, LogCtrlBlock *
 
     UINT32 lbn = LogPageToLogBlk(ctrlBlock[bank].logLpn);
     //UINT32 vbn = get_log_vbn(bank, lbn);
+    UINT32 logChunkAddr = (bank*LOG_BLK_PER_BANK*CHUNKS_PER_BLK) + (lbn*CHUNKS_PER_BLK) + (pageOffset*CHUNKS_PER_PAGE);
+
+#if OPTION_PAGE_VALID_SUMMARY
+    UINT32 mayBeValid = read_dram_8(PageValidSummary(logChunkAddr));
+    UINT32 nMayBeValid = 0;
+    for(UINT32 chunkOffset=0; chunkOffset<CHUNKS_PER_PAGE; chunkOffset++)
+    {
+        if (mayBeValid & ((UINT32)1 << chunkOffset))
+        { nMayBeValid++; }
+    }
+    if (nMayBeValid != 0 && nMayBeValid >= nValidChunksInPageToReuseThreshold)
+    {
+        uart_print("canReuseLowPage: summary rejects page "); uart_print_int(pageOffset); uart_print("\r\n");
+        return FALSE;
+    }
+#endif
+
     UINT32 victimLpns[CHUNKS_PER_PAGE];
     mem_copy(victimLpns, ctrlBlock[bank].lpnsListAddr + (pageOffset * CHUNKS_PER_PAGE * sizeof(UINT32)), CHUNKS_PER_PAGE * sizeof(UINT32));
 
-    UINT32 logChunkAddr = (bank*LOG_BLK_PER_BANK*CHUNKS_PER_BLK) + (lbn*CHUNKS_PER_BLK) + (pageOffset*CHUNKS_PER_PAGE);
-
     UINT32 dataChunkOffsets[CHUNKS_PER_PAGE];
     UINT32 dataLpns[CHUNKS_PER_PAGE];
     UINT32 validChunks[CHUNKS_PER_PAGE];
@@ -610,9 +930,13 @@ BOOL8 canReuseLowPage(const UINT32 bank, const UINT32 pageOffset, LogCtrlBlock *
         uart_print("chunkOffset "); uart_print_int(chunkOffset);
 
         UINT32 victimLpn = victimLpns[chunkOffset];
+#if OPTION_PAGE_VALID_SUMMARY
+        if ((mayBeValid & ((UINT32)1 << chunkOffset)) == 0)
+        { victimLpn = INVALID; }
+#endif
         if (victimLpn != INVALID)
         {
-            UINT32 i = mem_search_equ_dram_4_bytes(ChunksMapTable(victimLpn, 0), CHUNKS_PER_PAGE, logChunkAddr);
+            UINT32 i = findChunkIdx(victimLpn, logChunkAddr);
 
             if(i<CHUNKS_PER_PAGE)
             {
@@ -661,6 +985,26 @@ BOOL8 canReuseLowPage(const UINT32 bank, const UINT32 pageOffset, LogCtrlBlock *
         // note(fabio): this will be done in precacheLowPage
         //nand_page_ptread(bank, vbn, pageOffset, 0, SECTORS_PER_PAGE, PrecacheForEncoding(bank), RETURN_WHEN_DONE);
 
+#if OPTION_ASYNC_RELOCATION
+        commitResidualRelocation(bank); // at most one page per bank waits for relocation
+        relocPageChunkAddr[bank] = logChunkAddr - CHUNKS_PER_PAGE; // logChunkAddr was advanced past the page by the loop above
+#if OPTION_PRECACHE_RING
+        relocSlot[bank] = precacheTailSlot(bank); // the slot the page is queued in
+#endif
+        for(UINT32 chunkOffset=0; chunkOffset<CHUNKS_PER_PAGE; chunkOffset++)
+        {
+            relocLpn[bank][chunkOffset] = validChunks[chunkOffset] ? dataLpns[chunkOffset] : INVALID;
+            relocChunkIdx[bank][chunkOffset] = dataChunkOffsets[chunkOffset];
+        }
+        uart_print("canReuseLowPage: "); uart_print_int(nValidChunksInPage); uart_print(" chunks queued for relocation\r\n");
+#else
+        // The chunks are copied right away, so the page must be in the buffer before: the precache read has not run yet.
+#if OPTION_PRECACHE_RING
+        UINT32 relocBuf = PrecacheForEncodingSlot(bank, precacheTailSlot(bank));
+#else
+        UINT32 relocBuf = PrecacheForEncoding(bank);
+#endif
+        nand_page_ptread(bank, get_log_vbn(bank, lbn), pageOffset, 0, SECTORS_PER_PAGE, relocBuf, RETURN_WHEN_DONE);
         for(UINT32 chunkOffset=0; chunkOffset<CHUNKS_PER_PAGE; chunkOffset++)
         {
             if(validChunks[chunkOffset])
@@ -669,9 +1013,10 @@ BOOL8 canReuseLowPage(const UINT32 bank, const UINT32 pageOffset, LogCtrlBlock *
                                              dataLpns[chunkOffset],
                                              dataChunkOffsets[chunkOffset],
                                              chunkOffset,
-                                             PrecacheForEncoding(bank));
+                                             relocBuf);
             }
         }
+#endif
         //mem_set_dram(ctrlBlock[bank].lpnsListAddr + (pageOffset * CHUNKS_PER_PAGE * sizeof(UINT32)), INVALID, (CHUNKS_PER_PAGE * sizeof(UINT32)));
         UINT32 addrToClear = (ctrlBlock[bank].lpnsListAddr + (pageOffset * CHUNKS_PER_PAGE * sizeof(UINT32)));
         for (UINT32 i=0; i<CHUNKS_PER_PAGE; ++i)
@@ -685,6 +1030,113 @@ BOOL8 canReuseLowPage(const UINT32 bank, const UINT32 pageOffset, LogCtrlBlock *
 }
 
 
+#if OPTION_PRECACHE_RING
+/* Look-ahead precaching of the low pages of a hot block in second usage.
+ * The low pages are tested for reuse ahead of the write position, and up to NUM_PRECACHE_SLOTS accepted pages per bank
+ * wait in a ring, each one in its own encode buffer. Their reads are issued one at a time on idle banks, by the
+ * updateChunkPtr functions and the idle work, so that a page is normally in DRAM well before it is reprogrammed.
+ * The head of the ring is the page recorded in nextLowPageOffset. The scan stops at a page with residual chunks to
+ * relocate, because only one such page per bank can wait for its relocation. */
+static UINT32 ringPageOffset[NUM_BANKS][NUM_PRECACHE_SLOTS];
+static BOOL8 ringSlotRead[NUM_BANKS][NUM_PRECACHE_SLOTS];
+static UINT32 ringHead[NUM_BANKS];
+static UINT32 ringCount[NUM_BANKS];
+static UINT32 ringScanOffset[NUM_BANKS];    // next low page to test, INVALID when none is left in the block
+
+static void resetPrecacheRing(const UINT32 bank, const UINT32 firstPageOffset)
+{
+    ringHead[bank] = 0;
+    ringCount[bank] = 0;
+    ringScanOffset[bank] = firstPageOffset;
+}
+
+static UINT32 precacheTailSlot(const UINT32 bank)
+{
+    return (ringHead[bank] + ringCount[bank]) % NUM_PRECACHE_SLOTS;
+}
+
+static BOOL8 isPrecacheSlotRead(const UINT32 bank, const UINT32 slot)
+{
+    return ringSlotRead[bank][slot];
+}
+
+static void readPrecacheSlot(const UINT32 bank, const UINT32 slot, LogCtrlBlock * ctrlBlock)
+{
+    UINT32 vbn = get_log_vbn(bank, LogPageToLogBlk(ctrlBlock[bank].logLpn));
+    uart_print("readPrecacheSlot: bank "); uart_print_int(bank); uart_print(" pageOffset "); uart_print_int(ringPageOffset[bank][slot]);
+    uart_print(" slot "); uart_print_int(slot); uart_print("\r\n");
+    nand_page_ptread(bank, vbn, ringPageOffset[bank][slot], 0, SECTORS_PER_PAGE, PrecacheForEncodingSlot(bank, slot), RETURN_ON_ISSUE);
+    ringSlotRead[bank][slot] = TRUE;
+}
+
+// Tests the next low page of the block and queues it if it can be reused. Returns FALSE if the scan cannot go on now.
+static BOOL8 lookAheadLowPage(const UINT32 bank, LogCtrlBlock * ctrlBlock)
+{
+    UINT32 pageOffset = ringScanOffset[bank];
+    if (pageOffset == INVALID || ringCount[bank] == NUM_PRECACHE_SLOTS)
+    {
+        return FALSE;
+    }
+#if OPTION_ASYNC_RELOCATION
+    if (relocPageChunkAddr[bank] != INVALID)
+    {
+        return FALSE;
+    }
+#endif
+    UINT32 nextOffset = (pageOffset == 0) ? 1 : pageOffset + 2; // low pages are 0, 1 and then the odd ones
+    ringScanOffset[bank] = (nextOffset < UsedPagesPerLogBlk-1) ? nextOffset : INVALID;
+    if (canReuseLowPage(bank, pageOffset, ctrlBlock))
+    {
+        UINT32 slot = precacheTailSlot(bank);
+        ringPageOffset[bank][slot] = pageOffset;
+        ringSlotRead[bank][slot] = FALSE;
+        ringCount[bank]++;
+        uart_print("lookAheadLowPage: bank "); uart_print_int(bank); uart_print(" pageOffset "); uart_print_int(pageOffset);
+        uart_print(" queued in slot "); uart_print_int(slot); uart_print("\r\n");
+    }
+    return TRUE;
+}
+
+/* One step of look-ahead for an idle bank: reads the first queued page not read yet, otherwise tests one more low page.
+ * Returns TRUE if some work was done. */
+BOOL8 precacheAheadLowPage(const UINT32 bank, LogCtrlBlock * ctrlBlock)
+{
+    for (UINT32 i=0; i<ringCount[bank]; i++)
+    {
+        UINT32 slot = (ringHead[bank] + i) % NUM_PRECACHE_SLOTS;
+        if (ringSlotRead[bank][slot] == FALSE)
+        {
+            readPrecacheSlot(bank, slot, ctrlBlock);
+            return TRUE;
+        }
+    }
+    return lookAheadLowPage(bank, ctrlBlock);
+}
+
+// Frees the head of the ring once its page has been reprogrammed.
+void popPrecachedLowPage(const UINT32 bank)
+{
+    if (ringCount[bank] == 0)
+    {
+        uart_print_level_1("ERROR in popPrecachedLowPage: empty ring\r\n");
+        while(1);
+    }
+    ringHead[bank] = (ringHead[bank] + 1) % NUM_PRECACHE_SLOTS;
+    ringCount[bank]--;
+}
+#endif
+
+// Decides whether the low page at pageOffset is reused. Pages must be asked in increasing order within the block.
+static BOOL8 testLowPageForReuse(const UINT32 bank, const UINT32 pageOffset, LogCtrlBlock * ctrlBlock)
+{
+#if OPTION_PRECACHE_RING
+    while (ringScanOffset[bank] != INVALID && ringScanOffset[bank] <= pageOffset && lookAheadLowPage(bank, ctrlBlock));
+    return ringCount[bank] > 0 && ringPageOffset[bank][ringHead[bank]] == pageOffset;
+#else
+    return canReuseLowPage(bank, pageOffset, ctrlBlock);
+#endif
+}
+
 void precacheLowPage(const UINT32 bank, LogCtrlBlock * ctrlBlock)
 {
 
@@ -695,6 +1147,21 @@ void precacheLowPage(const UINT32 bank, LogCtrlBlock * ctrlBlock)
     //uart_print_level_1("\r\n");
 
 
+#if OPTION_PRECACHE_RING
+    // The page is the head of the ring, and it is read only if the look-ahead did not get to it already
+    if (ringCount[bank] == 0)
+    {
+        uart_print_level_1("ERROR in precacheLowPage: empty ring\r\n");
+        while(1);
+    }
+    uart_print("precacheLowPage: pageOffset ");
+    uart_print_int(ringPageOffset[bank][ringHead[bank]]);
+    uart_print("\r\n");
+    if (ringSlotRead[bank][ringHead[bank]] == FALSE)
+    {
+        readPrecacheSlot(bank, ringHead[bank], ctrlBlock);
+    }
+#else
     UINT32 lbn = LogPageToLogBlk(ctrlBlock[bank].logLpn);
     UINT32 vbn = get_log_vbn(bank, lbn);
     UINT32 pageOffset = ctrlBlock[bank].nextLowPageOffset;
@@ -704,6 +1171,7 @@ void precacheLowPage(const UINT32 bank, LogCtrlBlock * ctrlBlock)
     uart_print("\r\n");
 
     nand_page_ptread(bank, vbn, pageOffset, 0, SECTORS_PER_PAGE, PrecacheForEncoding(bank), RETURN_ON_ISSUE);
+#endif
     ctrlBlock[bank].precacheDone = TRUE;
 }
 
@@ -728,6 +1196,9 @@ void increaseLpnHotBlkSecondUsage (UINT32 const bank, LogCtrlBlock * ctrlBlock)
                             RETURN_WHEN_DONE); // write lpns list to the last high page
         mem_set_dram(ctrlBlock[bank].lpnsListAddr, INVALID, (CHUNKS_PER_BLK * CHUNK_ADDR_BYTES));
         insertBlkInHeap(&heapDataSecondUsage, bank, lbn);
+#if OPTION_PRECACHE_RING
+        resetPrecacheRing(bank, INVALID);
+#endif
 
         findNewLpnForHotLog(bank, ctrlBlock);
     }
@@ -759,7 +1230,7 @@ void increaseLpnHotBlkSecondUsage (UINT32 const bank, LogCtrlBlock * ctrlBlock)
 
                 if (pageOffset == 1)
                 { // Special case: pageOffset 1 comes immediately after another low page, so there was no time for precaching
-                    if(canReuseLowPage(bank, pageOffset, ctrlBlock))
+                    if(testLowPageForReuse(bank, pageOffset, ctrlBlock))
                     {
                         ctrlBlock[bank].updateChunkPtr = updateChunkPtrRecycledPage;
                         ctrlBlock[bank].useRecycledPage = TRUE;
@@ -782,7 +1253,7 @@ void increaseLpnHotBlkSecondUsage (UINT32 const bank, LogCtrlBlock * ctrlBlock)
                 pageOffset++;
                 if (pageOffset < UsedPagesPerLogBlk-1)
                 {
-                    if(canReuseLowPage(bank, pageOffset, ctrlBlock))
+                    if(testLowPageForReuse(bank, pageOffset, ctrlBlock))
                     {
                         ctrlBlock[bank].precacheDone = FALSE;
                         ctrlBlock[bank].nextLowPageOffset = pageOffset;
@@ -806,7 +1277,7 @@ void increaseLpnHotBlkSecondUsage (UINT32 const bank, LogCtrlBlock * ctrlBlock)
             pageOffset++;
             if (pageOffset < UsedPagesPerLogBlk-1)
             {
-                if(canReuseLowPage(bank, pageOffset, ctrlBlock))
+                if(testLowPageForReuse(bank, pageOffset, ctrlBlock))
                 {
                     ctrlBlock[bank].precacheDone = FALSE;
                     ctrlBlock[bank].nextLowPageOffset = pageOffset;
@@ -848,6 +1319,12 @@ void increaseLpnHotBlkFirstUsage (UINT32 const bank, LogCtrlBlock * ctrlBlock)
                             ctrlBlock[bank].lpnsListAddr,
                             RETURN_WHEN_DONE);
         mem_set_dram(ctrlBlock[bank].lpnsListAddr, INVALID, (CHUNKS_PER_BLK * CHUNK_ADDR_BYTES));
+#if OPTION_PAGE_VALID_SUMMARY
+        for (UINT32 page=pageOffset+1; page<PAGES_PER_BLK; page++)
+        { // no data after the last page, the lpns list page can be reused too
+            write_dram_8(BlkValidSummary(bank, lbn) + page, 0);
+        }
+#endif
         insertBlkInHeap(&heapDataFirstUsage, bank, lbn);
 
         findNewLpnForHotLog(bank, ctrlBlock);
@@ -905,9 +1382,8 @@ chunkLocation findChunkLocation(const UINT32 chunkAddr)
     if ( (chunkAddr & ColdLogBufBitFlag) > 0)
     {
         UINT32 realChunkAddr = chunkAddr & ~(ColdLogBufBitFlag);
-        UINT32 chunkOffset = ChunkToChunkOffsetInBank(realChunkAddr);
-        if (chunkOffset >= DramLogBufLpn * CHUNKS_PER_PAGE)
-        {
+        if (ChunkToPageOffset(realChunkAddr) == PAGES_PER_BLK - 1)
+        { // encoded chunks are only in low pages, the last page of a block addresses the buffer of a cold stream
             return DRAMColdLog;
         }
         else
@@ -14,5 +14,20 @@ void initLog();
 chunkLocation findChunkLocation(const UINT32 chunkAddr);
 UINT32 getLpnForCompletePage(const UINT32 bank, LogCtrlBlock * ctrlBlock);
 void precacheLowPage(const UINT32 bank, LogCtrlBlock * ctrlBlock);
+#if OPTION_ASYNC_RELOCATION
+BOOL8 relocateResidualChunkStep(const UINT32 skipBank);
+void commitResidualRelocation(const UINT32 bank);
+#endif
+#if OPTION_COLD_REUSE
+void coldReuseVictimFeedback(const UINT32 bank, const UINT32 lbn, const UINT32 nValidChunks);
+#endif
+#if OPTION_PRECACHE_RING
+BOOL8 precacheAheadLowPage(const UINT32 bank, LogCtrlBlock * ctrlBlock);
+void popPrecachedLowPage(const UINT32 bank);
+#endif
+#if OPTION_PAGE_VALID_SUMMARY
+void resetBlkValidSummary(const UINT32 bank, const UINT32 lbn);
+void clearChunkValidSummary(const UINT32 chunkAddr);
+#endif
 
 #endif
@@ -0,0 +1,124 @@
+#include "pendingMerge.h"
+#include "ftl_metadata.h"
+#include "ftl_parameters.h"
+#include "dram_layout.h"
+#include "flash.h" // WR_STAT
+#include "log.h" // get_log_vbn
+
+/* Pending merges of the asynchronous read-modify-write.
+ * When the host overwrites part of a chunk stored in flash, the old chunk is read into its slot of the log buffer
+ * with RETURN_ON_ISSUE, while the host sectors are parked in a PENDING_MERGE buffer, so that the SATA buffer can be
+ * released and the write path goes on. The host sectors are copied over the old data once the read is done:
+ * pendingMergePoll does it for the reads already completed, pendingMergeComplete waits for the merges falling in a
+ * DRAM range that is about to be read or programmed.
+ * A chunk of a recycled page is read encoded in the PENDING_MERGE_READ buffer of the merge instead, and decoded into
+ * the log buffer before the host sectors are copied.
+ * A read is known to be done when the waiting room is empty and its bank is idle. */
+
+#if OPTION_ASYNC_RMW
+
+static UINT32 mergeDst[NUM_PENDING_MERGES]; // chunk in the log buffer, INVALID if the slot is free
+static UINT32 mergeByteOffset[NUM_PENDING_MERGES];
+static UINT32 mergeBytes[NUM_PENDING_MERGES];
+static UINT8 mergeBank[NUM_PENDING_MERGES];
+static UINT8 mergeEncoded[NUM_PENDING_MERGES];
+static UINT32 mergeNextVictim;
+
+static void applyMerge(const UINT32 slot)
+{
+    uart_print("applyMerge: slot "); uart_print_int(slot); uart_print(" dst "); uart_print_int(mergeDst[slot]); uart_print("\r\n");
+    if (mergeEncoded[slot])
+    { // Decode PendingMergeReadBuf into the log buffer!!!
+        mem_copy(mergeDst[slot], PendingMergeReadBuf(slot), BYTES_PER_CHUNK);
+    }
+    mem_copy(mergeDst[slot] + mergeByteOffset[slot], PendingMergeBuf(slot) + mergeByteOffset[slot], mergeBytes[slot]);
+    mergeDst[slot] = INVALID;
+}
+
+static BOOL8 readDone(const UINT32 bank)
+{
+    return ((GETREG(WR_STAT) & 0x00000001) == 0 && isBankBusy(bank) == FALSE);
+}
+
+void pendingMergeInit()
+{
+    uart_print("pendingMergeInit: slots = "); uart_print_int(NUM_PENDING_MERGES); uart_print("\r\n");
+    for (UINT32 slot=0; slot<NUM_PENDING_MERGES; slot++)
+    {
+        mergeDst[slot] = INVALID;
+    }
+    mergeNextVictim = 0;
+}
+
+static UINT32 reserveSlot()
+{
+    UINT32 slot = mem_search_equ_sram_4_bytes(mergeDst, NUM_PENDING_MERGES, INVALID);
+    if (slot >= NUM_PENDING_MERGES)
+    { // table full: complete one merge, round robin
+        slot = mergeNextVictim;
+        mergeNextVictim = (mergeNextVictim + 1) % NUM_PENDING_MERGES;
+        uart_print("reserveSlot: table full, waiting for slot "); uart_print_int(slot); uart_print("\r\n");
+        waitBusyBank(mergeBank[slot]);
+        applyMerge(slot);
+    }
+    return slot;
+}
+
+static void recordMerge(const UINT32 slot, const UINT32 dstChunkAddr, const UINT32 srcChunkAddr, const UINT32 byteOffset, const UINT32 nBytes, const UINT32 readBank, const UINT8 encoded)
+{
+    mem_copy(PendingMergeBuf(slot) + byteOffset, srcChunkAddr + byteOffset, nBytes);
+    mergeDst[slot] = dstChunkAddr;
+    mergeByteOffset[slot] = byteOffset;
+    mergeBytes[slot] = nBytes;
+    mergeBank[slot] = readBank;
+    mergeEncoded[slot] = encoded;
+}
+
+// The read of the old chunk into dstChunkAddr must have been issued on readBank before calling this
+void pendingMergeAdd(const UINT32 dstChunkAddr, const UINT32 srcChunkAddr, const UINT32 byteOffset, const UINT32 nBytes, const UINT32 readBank)
+{
+    UINT32 slot = reserveSlot();
+    recordMerge(slot, dstChunkAddr, srcChunkAddr, byteOffset, nBytes, readBank, FALSE);
+}
+
+// Issues the read of the encoded chunk at oldChunkAddr (ColdLogBufBitFlag cleared) and parks the merge
+void pendingMergeAddEncoded(const UINT32 dstChunkAddr, const UINT32 srcChunkAddr, const UINT32 byteOffset, const UINT32 nBytes, const UINT32 oldChunkAddr)
+{
+    UINT32 slot = reserveSlot();
+    UINT32 oldBank = ChunkToBank(oldChunkAddr);
+    UINT32 srcByteOffset = ChunkToSectOffset(oldChunkAddr) * BYTES_PER_SECTOR;
+    nand_page_ptread(oldBank,
+                     get_log_vbn(oldBank, ChunkToLbn(oldChunkAddr)),
+                     ChunkToPageOffset(oldChunkAddr),
+                     srcByteOffset / BYTES_PER_SECTOR,
+                     SECTORS_PER_ENCODED_CHUNK,
+                     PendingMergeReadBuf(slot) - srcByteOffset, // buf addr + dst - src
+                     RETURN_ON_ISSUE);
+    recordMerge(slot, dstChunkAddr, srcChunkAddr, byteOffset, nBytes, oldBank, TRUE);
+}
+
+void pendingMergePoll()
+{
+    for (UINT32 slot=0; slot<NUM_PENDING_MERGES; slot++)
+    {
+        if (mergeDst[slot] != INVALID && readDone(mergeBank[slot]))
+        {
+            applyMerge(slot);
+        }
+    }
+}
+
+// Completes, waiting for their reads if needed, the merges into [addr, addr + nBytes)
+void pendingMergeComplete(const UINT32 addr, const UINT32 nBytes)
+{
+    for (UINT32 slot=0; slot<NUM_PENDING_MERGES; slot++)
+    {
+        if (mergeDst[slot] != INVALID && mergeDst[slot] >= addr && mergeDst[slot] < addr + nBytes)
+        {
+            waitBusyBank(mergeBank[slot]);
+            applyMerge(slot);
+        }
+    }
+}
+
+#endif
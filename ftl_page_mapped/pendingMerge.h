@@ -0,0 +1,11 @@
+#ifndef PENDING_MERGE_H
+#define PENDING_MERGE_H
+#include "jasmine.h"
+
+void pendingMergeInit();
+void pendingMergeAdd(const UINT32 dstChunkAddr, const UINT32 srcChunkAddr, const UINT32 byteOffset, const UINT32 nBytes, const UINT32 readBank);
+void pendingMergeAddEncoded(const UINT32 dstChunkAddr, const UINT32 srcChunkAddr, const UINT32 byteOffset, const UINT32 nBytes, const UINT32 oldChunkAddr);
+void pendingMergePoll();
+void pendingMergeComplete(const UINT32 addr, const UINT32 nBytes);
+
+#endif
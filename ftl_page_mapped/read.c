@@ -3,6 +3,12 @@
 #include "log.h"
 #include "garbage_collection.h"
 #include "heap.h" // decrementValidChunks
+#include "readCache.h"
+#include "readAhead.h"
+#include "chunksMap.h"
+#include "pendingMerge.h"
+#include "sectorOverlay.h"
+#include "read.h"
 
 // Private methods
 static void initRead(const UINT32 dataLpn, const UINT32 sectOffset, const UINT32 nSects, const UINT8 mode);
@@ -17,7 +23,6 @@ static void readCompletePage(UINT32 *chunksInPage, UINT32 *srcChunkByteOffsets,
 static void readCompletePageEncoded(UINT32 *chunksInPage, UINT32 *srcChunkByteOffsets, UINT32 *chunkIdxs);
 static void readOneChunk(UINT32 *chunksInPage, UINT32 *srcChunkByteOffsets, UINT32 *chunkIdxs);
 static void readOneChunkEncoded(UINT32 *chunksInPage, UINT32 *srcChunkByteOffsets, UINT32 *chunkIdxs);
-static void rebuildPageToFtlBuf(const UINT32 dataLpn, const UINT32 sectOffset, const UINT32 nSects, const UINT8 mode);
 
 // Private data
 UINT32 lpn_;
@@ -82,11 +87,7 @@ void rebuildPageToFtlBuf(const UINT32 dataLpn, const UINT32 sectOffset, const UI
         {
             chunksDone_[chunkIdx_] = 1;
             //oldChunkAddr_ = getChunkAddr(node_, chunkIdx_);
-            if (ChunksMapTable(dataLpn, chunkIdx_) > DRAM_BASE + DRAM_SIZE)
-            {
-                uart_print_level_1("ERROR in rebuildPageToFtlBuf 1: reading above DRAM address space\r\n");
-            }
-            oldChunkAddr_ = read_dram_32(ChunksMapTable(dataLpn, chunkIdx_));
+            oldChunkAddr_ = getChunkAddr(dataLpn, chunkIdx_);
             uart_print("oldChunkAddr is "); uart_print_int(oldChunkAddr_); uart_print("\r\n");
             switch (findChunkLocation(oldChunkAddr_))
             {
@@ -115,6 +116,9 @@ void rebuildPageToFtlBuf(const UINT32 dataLpn, const UINT32 sectOffset, const UI
                     uart_print(" in DRAM hot log\r\n");
                     UINT32 dst = FTL_BUF(0) + (chunkIdx_*BYTES_PER_CHUNK);
                     UINT32 src = hotLogCtrl[ChunkToBank(oldChunkAddr_)].logBufferAddr+(ChunkToSectOffset(oldChunkAddr_)*BYTES_PER_SECTOR);
+#if OPTION_ASYNC_RMW
+                    pendingMergeComplete(src, BYTES_PER_CHUNK);
+#endif
                     mem_copy(dst, src, BYTES_PER_CHUNK);
                     if (mode_ == GcMode) hotLogCtrl[ChunkToBank(oldChunkAddr_)].dataLpn[oldChunkAddr_ % CHUNKS_PER_PAGE] = INVALID;
                     break;
@@ -125,9 +129,12 @@ void rebuildPageToFtlBuf(const UINT32 dataLpn, const UINT32 sectOffset, const UI
                     oldChunkAddr_ = oldChunkAddr_ & ~(ColdLogBufBitFlag);
                     uart_print("masked oldChunkAddr is "); uart_print_int(oldChunkAddr_); uart_print("\r\n");
                     UINT32 dst = FTL_BUF(0) + (chunkIdx_*BYTES_PER_CHUNK);
-                    UINT32 src = coldLogCtrl[ChunkToBank(oldChunkAddr_)].logBufferAddr+(ChunkToSectOffset(oldChunkAddr_)*BYTES_PER_SECTOR);
+                    UINT32 src = ColdStreamCtrlOfBufChunk(oldChunkAddr_)[ChunkToBank(oldChunkAddr_)].logBufferAddr+(ChunkToSectOffset(oldChunkAddr_)*BYTES_PER_SECTOR);
+#if OPTION_ASYNC_RMW
+                    pendingMergeComplete(src, BYTES_PER_CHUNK);
+#endif
                     mem_copy(dst, src, BYTES_PER_CHUNK);
-                    if (mode_ == GcMode) coldLogCtrl[ChunkToBank(oldChunkAddr_)].dataLpn[oldChunkAddr_ % CHUNKS_PER_PAGE] = INVALID;
+                    if (mode_ == GcMode) ColdStreamCtrlOfBufChunk(oldChunkAddr_)[ChunkToBank(oldChunkAddr_)].dataLpn[oldChunkAddr_ % CHUNKS_PER_PAGE] = INVALID;
                     break;
                 }
             }
@@ -137,6 +144,12 @@ void rebuildPageToFtlBuf(const UINT32 dataLpn, const UINT32 sectOffset, const UI
             uart_print(" already done\r\n");
         }
     }
+#if OPTION_SECTOR_OVERLAY
+    for (UINT32 chunkIdx = sectOffset / SECTORS_PER_CHUNK; chunkIdx<lastChunk_; chunkIdx++)
+    {
+        sectorOverlayApply(dataLpn, chunkIdx, FTL_BUF(0) + (chunkIdx*BYTES_PER_CHUNK));
+    }
+#endif
 }
 
 static void chunkInFlashLog()
@@ -171,11 +184,7 @@ static void setupFlashPageReadEncoded(UINT32 * chunksInPage, UINT32 * srcChunkBy
         uart_print("next chunk: "); uart_print_int(i); uart_print("\r\n");
         if (chunksDone_[i] == 0)
         {
-            if (ChunksMapTable(lpn_, i) > DRAM_BASE + DRAM_SIZE)
-            {
-                uart_print_level_1("ERROR in setupFlashPageRead 1: reading above DRAM address space\r\n");
-            }
-            UINT32 nextChunkAddr = read_dram_32(ChunksMapTable(lpn_, i));
+            UINT32 nextChunkAddr = getChunkAddr(lpn_, i);
             switch (findChunkLocation(nextChunkAddr))
             {
                 case FlashWLogEncoded:
@@ -213,9 +222,9 @@ static void readFlashPageEncoded(UINT32 *chunksInPage, UINT32 *srcChunkByteOffse
 {
     uart_print("readFlashPageEncoded\r\n");
 
-    if(*chunksInPage > 3)
+    if(*chunksInPage > CHUNKS_PER_RECYCLED_PAGE)
     {
-        uart_print_level_1("ERROR in readFlashPageEncoded: found more than 3 valid chunks in encoded page\r\n");
+        uart_print_level_1("ERROR in readFlashPageEncoded: found more than CHUNKS_PER_RECYCLED_PAGE valid chunks in encoded page\r\n");
         while(1);
     }
 
@@ -237,11 +246,7 @@ static void setupFlashPageRead(UINT32 * chunksInPage, UINT32 * srcChunkByteOffse
         uart_print("next chunk: "); uart_print_int(i); uart_print("\r\n");
         if (chunksDone_[i] == 0)
         {
-            if (ChunksMapTable(lpn_, i) > DRAM_BASE + DRAM_SIZE)
-            {
-                uart_print_level_1("ERROR in setupFlashPageRead 1: reading above DRAM address space\r\n");
-            }
-            UINT32 nextChunkAddr = read_dram_32(ChunksMapTable(lpn_, i));
+            UINT32 nextChunkAddr = getChunkAddr(lpn_, i);
             switch (findChunkLocation(nextChunkAddr))
             {
                 case Invalid:
@@ -314,6 +319,9 @@ static void readCompletePageEncoded(UINT32 *chunksInPage, UINT32 *srcChunkByteOf
             decrementValidChunks(&heapDataFirstUsage, oldLogBank, ChunkToLbn(oldChunkAddr_));
             decrementValidChunks(&heapDataSecondUsage, oldLogBank, ChunkToLbn(oldChunkAddr_));
             decrementValidChunks(&heapDataCold, oldLogBank, ChunkToLbn(oldChunkAddr_));
+#if OPTION_PAGE_VALID_SUMMARY
+            clearChunkValidSummary(oldChunkAddr_);
+#endif
         }
     }
 }
@@ -336,6 +344,9 @@ static void readCompletePage(UINT32 *chunksInPage, UINT32 *srcChunkByteOffsets,
             decrementValidChunks(&heapDataFirstUsage, oldLogBank, ChunkToLbn(oldChunkAddr_));
             decrementValidChunks(&heapDataSecondUsage, oldLogBank, ChunkToLbn(oldChunkAddr_));
             decrementValidChunks(&heapDataCold, oldLogBank, ChunkToLbn(oldChunkAddr_));
+#if OPTION_PAGE_VALID_SUMMARY
+            clearChunkValidSummary(oldChunkAddr_);
+#endif
         }
     }
 }
@@ -361,6 +372,9 @@ static void readOneChunkEncoded(UINT32 *chunksInPage, UINT32 *srcChunkByteOffset
         decrementValidChunks(&heapDataFirstUsage, bank, ChunkToLbn(oldChunkAddr_));
         decrementValidChunks(&heapDataSecondUsage, bank, ChunkToLbn(oldChunkAddr_));
         decrementValidChunks(&heapDataCold, bank, ChunkToLbn(oldChunkAddr_));
+#if OPTION_PAGE_VALID_SUMMARY
+        clearChunkValidSummary(oldChunkAddr_);
+#endif
     }
 }
 
@@ -377,6 +391,9 @@ static void readOneChunk(UINT32 *chunksInPage, UINT32 *srcChunkByteOffsets, UINT
         decrementValidChunks(&heapDataFirstUsage, bank, ChunkToLbn(oldChunkAddr_));
         decrementValidChunks(&heapDataSecondUsage, bank, ChunkToLbn(oldChunkAddr_));
         decrementValidChunks(&heapDataCold, bank, ChunkToLbn(oldChunkAddr_));
+#if OPTION_PAGE_VALID_SUMMARY
+        clearChunkValidSummary(oldChunkAddr_);
+#endif
     }
 }
 
@@ -388,8 +405,24 @@ void readFromLogBlk (UINT32 const dataLpn, UINT32 const sectOffset, UINT32 const
 
     UINT32 dst = RD_BUF_PTR(g_ftl_read_buf_id)+(sectOffset*BYTES_PER_SECTOR);
     UINT32 src = FTL_BUF(0)+(sectOffset*BYTES_PER_SECTOR);
-    rebuildPageToFtlBuf(dataLpn, sectOffset, nSects, ReadMode);
-    mem_copy(dst, src, nSects*BYTES_PER_SECTOR);
+    BOOL8 hit = FALSE;
+#if OPTION_READ_CACHE
+    hit = readCacheLookup(dataLpn, sectOffset, nSects, RD_BUF_PTR(g_ftl_read_buf_id));
+#endif
+#if OPTION_READ_AHEAD
+    if (hit == FALSE)
+    {
+        hit = readAheadLookup(dataLpn, sectOffset, nSects, RD_BUF_PTR(g_ftl_read_buf_id));
+    }
+#endif
+    if (hit == FALSE)
+    {
+        rebuildPageToFtlBuf(dataLpn, sectOffset, nSects, ReadMode);
+#if OPTION_READ_CACHE
+        readCacheInsert(dataLpn, sectOffset, nSects, FTL_BUF(0));
+#endif
+        mem_copy(dst, src, nSects*BYTES_PER_SECTOR);
+    }
     g_ftl_read_buf_id = (g_ftl_read_buf_id + 1) % NUM_RD_BUFFERS;
     SETREG (BM_STACK_RDSET, g_ftl_read_buf_id);    // change bm_read_limit
     SETREG (BM_STACK_RESET, 0x02);    // change bm_read_limit
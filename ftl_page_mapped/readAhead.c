@@ -0,0 +1,331 @@
+#include "readAhead.h"
+#include "ftl_metadata.h"
+#include "ftl_parameters.h"
+#include "dram_layout.h"
+#include "log.h" // findChunkLocation, get_log_vbn
+#include "flash.h" // RETURN_ON_ISSUE
+#include "chunksMap.h" // getPageChunkAddrs
+#include "pendingMerge.h"
+#include "sectorOverlay.h"
+
+/* Sequential read-ahead.
+ * ftl_read reports every host read to a small stream detector. Once a stream has been read
+ * sequentially readAheadTrigger times, and the host left read look-ahead enabled, the next
+ * readAheadDepth logical pages are prefetched in the READ_AHEAD buffers.
+ * Prefetching is opportunistic: a page is prefetched only if every bank holding one of its
+ * chunks is idle, and the reads are issued with RETURN_ON_ISSUE. The banks still working for a
+ * buffer are remembered, so that we wait for them only when the buffer is consumed or reused.
+ * Chunks that share a flash page are read with a single full page read into one of the staging pages of the buffer,
+ * and copied into the buffer once the page is consumed, like readCompletePage does. A page that would need more
+ * staging pages than NUM_READ_AHEAD_STAGE_PAGES is left to the normal read path.
+ * Encoded chunks are not prefetched, the page is left to the normal read path. */
+
+#if OPTION_READ_AHEAD
+
+static UINT32 raLpn[NUM_READ_AHEAD_BUFFERS];
+static UINT32 raPendingBanks[NUM_READ_AHEAD_BUFFERS]; // bitmap of banks that may still be transferring into the buffer
+static UINT32 raNextBuf;
+static UINT32 raStagedSrc[NUM_READ_AHEAD_BUFFERS][CHUNKS_PER_PAGE]; // address of the chunk in a staging page, INVALID if it was read in place
+
+static UINT32 streamNextLba[NUM_READ_STREAMS];
+static UINT32 streamSeqReads[NUM_READ_STREAMS];
+static UINT32 streamPrefetchedLpn[NUM_READ_STREAMS]; // first lpn after the pages already prefetched for the stream
+static UINT32 streamNextSlot;
+
+static UINT32 findBuf(const UINT32 dataLpn)
+{
+    return mem_search_equ_sram_4_bytes(raLpn, NUM_READ_AHEAD_BUFFERS, dataLpn);
+}
+
+static void waitPendingBanks(const UINT32 buf)
+{
+    for (UINT32 bank=0; bank<NUM_BANKS; bank++)
+    {
+        if (raPendingBanks[buf] & ((UINT32)1 << bank))
+        {
+            waitBusyBank(bank);
+        }
+    }
+    raPendingBanks[buf] = 0;
+}
+
+static void copyStagedChunks(const UINT32 buf)
+{
+    for (UINT32 chunkIdx=0; chunkIdx<CHUNKS_PER_PAGE; chunkIdx++)
+    {
+        if (raStagedSrc[buf][chunkIdx] != INVALID)
+        {
+            mem_copy(ReadAheadBuf(buf) + (chunkIdx * BYTES_PER_CHUNK), raStagedSrc[buf][chunkIdx], BYTES_PER_CHUNK);
+            raStagedSrc[buf][chunkIdx] = INVALID;
+        }
+    }
+}
+
+// Index of an earlier chunk of the page stored in the same flash page, CHUNKS_PER_PAGE if none
+static UINT32 prevChunkInFlashPage(const UINT32 * chunkAddrs, const UINT32 * locations, const UINT32 chunkIdx)
+{
+    for (UINT32 prev=0; prev<chunkIdx; prev++)
+    {
+        if (locations[prev] == FlashWLog && chunkAddrs[prev] / CHUNKS_PER_PAGE == chunkAddrs[chunkIdx] / CHUNKS_PER_PAGE)
+        {
+            return prev;
+        }
+    }
+    return CHUNKS_PER_PAGE;
+}
+
+static BOOL8 nextChunkInFlashPage(const UINT32 * chunkAddrs, const UINT32 * locations, const UINT32 chunkIdx)
+{
+    for (UINT32 next=chunkIdx+1; next<CHUNKS_PER_PAGE; next++)
+    {
+        if (locations[next] == FlashWLog && chunkAddrs[next] / CHUNKS_PER_PAGE == chunkAddrs[chunkIdx] / CHUNKS_PER_PAGE)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static BOOL8 prefetchPage(const UINT32 dataLpn)
+{
+    if (dataLpn >= NUM_BANKS * DATA_BLK_PER_BANK * PAGES_PER_VBLK)
+    {
+        return FALSE;
+    }
+    if (findBuf(dataLpn) < NUM_READ_AHEAD_BUFFERS)
+    {
+        return TRUE;
+    }
+#if OPTION_SECTOR_OVERLAY
+    if (sectorOverlayHasLpn(dataLpn))
+    { // the overlay is applied by the normal read path
+        return FALSE;
+    }
+#endif
+
+    UINT32 chunkAddrs[CHUNKS_PER_PAGE];
+    UINT32 locations[CHUNKS_PER_PAGE];
+    UINT32 stagesNeeded = 0;
+    getPageChunkAddrs(dataLpn, chunkAddrs);
+
+    for (UINT32 chunkIdx=0; chunkIdx<CHUNKS_PER_PAGE; chunkIdx++)
+    {
+        locations[chunkIdx] = findChunkLocation(chunkAddrs[chunkIdx]);
+        switch (locations[chunkIdx])
+        {
+            case FlashWLogEncoded:
+            {
+                uart_print("prefetchPage: lpn "); uart_print_int(dataLpn); uart_print(" has encoded chunks\r\n");
+                return FALSE;
+            }
+            case FlashWLog:
+            {
+                if (isBankBusy(ChunkToBank(chunkAddrs[chunkIdx])))
+                {
+                    uart_print("prefetchPage: lpn "); uart_print_int(dataLpn); uart_print(" is on a busy bank\r\n");
+                    return FALSE;
+                }
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+    }
+    for (UINT32 chunkIdx=0; chunkIdx<CHUNKS_PER_PAGE; chunkIdx++)
+    {
+        if (locations[chunkIdx] == FlashWLog &&
+            prevChunkInFlashPage(chunkAddrs, locations, chunkIdx) == CHUNKS_PER_PAGE &&
+            nextChunkInFlashPage(chunkAddrs, locations, chunkIdx))
+        {
+            stagesNeeded++;
+        }
+    }
+    if (stagesNeeded > NUM_READ_AHEAD_STAGE_PAGES)
+    {
+        uart_print("prefetchPage: lpn "); uart_print_int(dataLpn); uart_print(" spans too many shared flash pages\r\n");
+        return FALSE;
+    }
+
+    UINT32 buf = raNextBuf;
+    raNextBuf = (raNextBuf + 1) % NUM_READ_AHEAD_BUFFERS;
+    waitPendingBanks(buf);
+    for (UINT32 chunkIdx=0; chunkIdx<CHUNKS_PER_PAGE; chunkIdx++)
+    {
+        raStagedSrc[buf][chunkIdx] = INVALID;
+    }
+    raLpn[buf] = dataLpn;
+    UINT32 nextStage = 0;
+    uart_print("prefetchPage: lpn "); uart_print_int(dataLpn); uart_print(" in buffer "); uart_print_int(buf); uart_print("\r\n");
+
+    for (UINT32 chunkIdx=0; chunkIdx<CHUNKS_PER_PAGE; chunkIdx++)
+    {
+        UINT32 chunkAddr = chunkAddrs[chunkIdx];
+        UINT32 dst = ReadAheadBuf(buf) + (chunkIdx * BYTES_PER_CHUNK);
+        switch (locations[chunkIdx])
+        {
+            case Invalid:
+            {
+                mem_set_dram(dst, INVALID, BYTES_PER_CHUNK);
+                break;
+            }
+            case FlashWLog:
+            {
+                UINT32 bank = ChunkToBank(chunkAddr);
+                UINT32 srcByteOffset = ChunkToSectOffset(chunkAddr) * BYTES_PER_SECTOR;
+                UINT32 prev = prevChunkInFlashPage(chunkAddrs, locations, chunkIdx);
+                if (prev < CHUNKS_PER_PAGE)
+                { // the flash page is already being read into a staging page
+                    UINT32 stageAddr = raStagedSrc[buf][prev] - (ChunkToSectOffset(chunkAddrs[prev]) * BYTES_PER_SECTOR);
+                    raStagedSrc[buf][chunkIdx] = stageAddr + srcByteOffset;
+                    break;
+                }
+                if (nextChunkInFlashPage(chunkAddrs, locations, chunkIdx))
+                { // read the whole flash page once
+                    UINT32 stageAddr = ReadAheadStage(buf, nextStage);
+                    nextStage++;
+                    nand_page_ptread(bank,
+                                     get_log_vbn(bank, ChunkToLbn(chunkAddr)),
+                                     ChunkToPageOffset(chunkAddr),
+                                     0,
+                                     SECTORS_PER_PAGE,
+                                     stageAddr,
+                                     RETURN_ON_ISSUE);
+                    raStagedSrc[buf][chunkIdx] = stageAddr + srcByteOffset;
+                    raPendingBanks[buf] |= ((UINT32)1 << bank);
+                    break;
+                }
+                nand_page_ptread(bank,
+                                 get_log_vbn(bank, ChunkToLbn(chunkAddr)),
+                                 ChunkToPageOffset(chunkAddr),
+                                 srcByteOffset / BYTES_PER_SECTOR,
+                                 SECTORS_PER_CHUNK,
+                                 dst - srcByteOffset, // buf addr + dst - src
+                                 RETURN_ON_ISSUE);
+                raPendingBanks[buf] |= ((UINT32)1 << bank);
+                break;
+            }
+            case DRAMHotLog:
+            {
+                UINT32 src = hotLogCtrl[ChunkToBank(chunkAddr)].logBufferAddr + (ChunkToSectOffset(chunkAddr) * BYTES_PER_SECTOR);
+#if OPTION_ASYNC_RMW
+                pendingMergeComplete(src, BYTES_PER_CHUNK);
+#endif
+                mem_copy(dst, src, BYTES_PER_CHUNK);
+                break;
+            }
+            case DRAMColdLog:
+            {
+                chunkAddr = chunkAddr & ~(ColdLogBufBitFlag);
+                UINT32 src = ColdStreamCtrlOfBufChunk(chunkAddr)[ChunkToBank(chunkAddr)].logBufferAddr + (ChunkToSectOffset(chunkAddr) * BYTES_PER_SECTOR);
+#if OPTION_ASYNC_RMW
+                pendingMergeComplete(src, BYTES_PER_CHUNK);
+#endif
+                mem_copy(dst, src, BYTES_PER_CHUNK);
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+    }
+    return TRUE;
+}
+
+void readAheadInit()
+{
+    uart_print("readAheadInit: buffers = "); uart_print_int(NUM_READ_AHEAD_BUFFERS); uart_print("\r\n");
+    for (UINT32 buf=0; buf<NUM_READ_AHEAD_BUFFERS; buf++)
+    {
+        raLpn[buf] = INVALID;
+        raPendingBanks[buf] = 0;
+        for (UINT32 chunkIdx=0; chunkIdx<CHUNKS_PER_PAGE; chunkIdx++)
+        {
+            raStagedSrc[buf][chunkIdx] = INVALID;
+        }
+    }
+    raNextBuf = 0;
+    for (UINT32 stream=0; stream<NUM_READ_STREAMS; stream++)
+    {
+        streamNextLba[stream] = INVALID;
+        streamSeqReads[stream] = 0;
+        streamPrefetchedLpn[stream] = INVALID;
+    }
+    streamNextSlot = 0;
+}
+
+void readAheadDetectStream(const UINT32 lba, const UINT32 nSects)
+{
+    UINT32 stream;
+    for (stream=0; stream<NUM_READ_STREAMS; stream++)
+    {
+        if (streamNextLba[stream] == lba)
+        {
+            break;
+        }
+    }
+    if (stream == NUM_READ_STREAMS)
+    { // not a continuation of a known stream, replace the oldest one
+        stream = streamNextSlot;
+        streamNextSlot = (streamNextSlot + 1) % NUM_READ_STREAMS;
+        streamSeqReads[stream] = 0;
+        streamPrefetchedLpn[stream] = INVALID;
+    }
+    else
+    {
+        streamSeqReads[stream]++;
+    }
+    streamNextLba[stream] = lba + nSects;
+
+    if (g_sata_context.read_look_ahead_enabled == FALSE || streamSeqReads[stream] < readAheadTrigger)
+    {
+        return;
+    }
+
+    UINT32 depth = readAheadDepth < NUM_READ_AHEAD_BUFFERS ? readAheadDepth : NUM_READ_AHEAD_BUFFERS;
+    UINT32 nextLpn = (lba + nSects) / SECTORS_PER_PAGE;
+    UINT32 lpn = nextLpn;
+    if (streamPrefetchedLpn[stream] != INVALID && streamPrefetchedLpn[stream] > nextLpn)
+    {
+        lpn = streamPrefetchedLpn[stream];
+    }
+    uart_print("readAheadDetectStream: stream "); uart_print_int(stream); uart_print(" prefetch from lpn "); uart_print_int(lpn); uart_print("\r\n");
+    for (; lpn < nextLpn + depth; lpn++)
+    {
+        if (prefetchPage(lpn) == FALSE)
+        {
+            break;
+        }
+    }
+    streamPrefetchedLpn[stream] = lpn;
+}
+
+// Copies the requested sectors into the page at dstPageAddr (same sector offset). Returns TRUE on hit.
+BOOL8 readAheadLookup(const UINT32 dataLpn, const UINT32 sectOffset, const UINT32 nSects, const UINT32 dstPageAddr)
+{
+    UINT32 buf = findBuf(dataLpn);
+    if (buf >= NUM_READ_AHEAD_BUFFERS)
+    {
+        return FALSE;
+    }
+    uart_print("readAheadLookup: hit lpn "); uart_print_int(dataLpn); uart_print(" in buffer "); uart_print_int(buf); uart_print("\r\n");
+    waitPendingBanks(buf);
+    copyStagedChunks(buf);
+    mem_copy(dstPageAddr + (sectOffset * BYTES_PER_SECTOR), ReadAheadBuf(buf) + (sectOffset * BYTES_PER_SECTOR), nSects * BYTES_PER_SECTOR);
+    return TRUE;
+}
+
+// The buffer is dropped but the pending banks are kept, since a transfer into it may still be in flight.
+void readAheadInvalidate(const UINT32 dataLpn)
+{
+    UINT32 buf = findBuf(dataLpn);
+    if (buf < NUM_READ_AHEAD_BUFFERS)
+    {
+        uart_print("readAheadInvalidate: lpn "); uart_print_int(dataLpn); uart_print(" in buffer "); uart_print_int(buf); uart_print("\r\n");
+        raLpn[buf] = INVALID;
+    }
+}
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef READ_AHEAD_H
+#define READ_AHEAD_H
+#include "jasmine.h"
+
+void readAheadInit();
+void readAheadDetectStream(const UINT32 lba, const UINT32 nSects);
+BOOL8 readAheadLookup(const UINT32 dataLpn, const UINT32 sectOffset, const UINT32 nSects, const UINT32 dstPageAddr);
+void readAheadInvalidate(const UINT32 dataLpn);
+
+#endif
@@ -0,0 +1,112 @@
+#include "readCache.h"
+#include "ftl_metadata.h"
+#include "ftl_parameters.h"
+#include "dram_layout.h"
+
+/* Page-granular read cache for hot logical pages.
+ * The cached pages live in the READ_CACHE region of DRAM, while the index is kept in SRAM:
+ * for every slot we store the data lpn, a bitmap of the chunks that are present, and the
+ * reference bit used by the CLOCK replacement policy.
+ * Chunks are inserted after being rebuilt in FTL_BUF by a host read, therefore a slot can be
+ * only partially filled. Every host write and trim on an lpn drops its slot. GC never changes
+ * the content of a logical page, so it does not need to touch the cache. */
+
+#if OPTION_READ_CACHE
+
+static UINT32 readCacheLpn[NUM_READ_CACHE_PAGES];
+static UINT32 readCacheValidChunks[NUM_READ_CACHE_PAGES];
+static UINT8 readCacheRefBit[NUM_READ_CACHE_PAGES];
+static UINT32 clockHand;
+
+static UINT32 chunksBitmap(const UINT32 sectOffset, const UINT32 nSects)
+{
+    UINT32 firstChunk = sectOffset / SECTORS_PER_CHUNK;
+    UINT32 lastChunk = (sectOffset + nSects + SECTORS_PER_CHUNK - 1) / SECTORS_PER_CHUNK;
+    UINT32 bitmap = 0;
+    for (UINT32 i=firstChunk; i<lastChunk; i++)
+    {
+        bitmap |= (1 << i);
+    }
+    return bitmap;
+}
+
+static UINT32 findSlot(const UINT32 dataLpn)
+{
+    return mem_search_equ_sram_4_bytes(readCacheLpn, NUM_READ_CACHE_PAGES, dataLpn);
+}
+
+static UINT32 clockVictim()
+{
+    while (readCacheRefBit[clockHand] == 1)
+    {
+        readCacheRefBit[clockHand] = 0;
+        clockHand = (clockHand + 1) % NUM_READ_CACHE_PAGES;
+    }
+    UINT32 victim = clockHand;
+    clockHand = (clockHand + 1) % NUM_READ_CACHE_PAGES;
+    return victim;
+}
+
+void readCacheInit()
+{
+    uart_print("readCacheInit: slots = "); uart_print_int(NUM_READ_CACHE_PAGES); uart_print("\r\n");
+    for (UINT32 slot=0; slot<NUM_READ_CACHE_PAGES; slot++)
+    {
+        readCacheLpn[slot] = INVALID;
+        readCacheValidChunks[slot] = 0;
+        readCacheRefBit[slot] = 0;
+    }
+    clockHand = 0;
+}
+
+// Copies the requested sectors into the page at dstPageAddr (same sector offset). Returns TRUE on hit.
+BOOL8 readCacheLookup(const UINT32 dataLpn, const UINT32 sectOffset, const UINT32 nSects, const UINT32 dstPageAddr)
+{
+    UINT32 slot = findSlot(dataLpn);
+    if (slot >= NUM_READ_CACHE_PAGES)
+    {
+        return FALSE;
+    }
+    UINT32 bitmap = chunksBitmap(sectOffset, nSects);
+    if ((readCacheValidChunks[slot] & bitmap) != bitmap)
+    {
+        uart_print("readCacheLookup: lpn "); uart_print_int(dataLpn); uart_print(" partially cached\r\n");
+        return FALSE;
+    }
+    uart_print("readCacheLookup: hit lpn "); uart_print_int(dataLpn); uart_print(" in slot "); uart_print_int(slot); uart_print("\r\n");
+    readCacheRefBit[slot] = 1;
+    mem_copy(dstPageAddr + (sectOffset * BYTES_PER_SECTOR), ReadCacheBuf(slot) + (sectOffset * BYTES_PER_SECTOR), nSects * BYTES_PER_SECTOR);
+    return TRUE;
+}
+
+// srcPageAddr holds the rebuilt page: all the chunks overlapping the sector range must be complete.
+void readCacheInsert(const UINT32 dataLpn, const UINT32 sectOffset, const UINT32 nSects, const UINT32 srcPageAddr)
+{
+    UINT32 slot = findSlot(dataLpn);
+    if (slot >= NUM_READ_CACHE_PAGES)
+    {
+        slot = clockVictim();
+        uart_print("readCacheInsert: lpn "); uart_print_int(dataLpn); uart_print(" evicts slot "); uart_print_int(slot); uart_print("\r\n");
+        readCacheLpn[slot] = dataLpn;
+        readCacheValidChunks[slot] = 0;
+        readCacheRefBit[slot] = 0;
+    }
+    UINT32 firstChunk = sectOffset / SECTORS_PER_CHUNK;
+    UINT32 lastChunk = (sectOffset + nSects + SECTORS_PER_CHUNK - 1) / SECTORS_PER_CHUNK;
+    mem_copy(ReadCacheBuf(slot) + (firstChunk * BYTES_PER_CHUNK), srcPageAddr + (firstChunk * BYTES_PER_CHUNK), (lastChunk - firstChunk) * BYTES_PER_CHUNK);
+    readCacheValidChunks[slot] |= chunksBitmap(sectOffset, nSects);
+}
+
+void readCacheInvalidate(const UINT32 dataLpn)
+{
+    UINT32 slot = findSlot(dataLpn);
+    if (slot < NUM_READ_CACHE_PAGES)
+    {
+        uart_print("readCacheInvalidate: lpn "); uart_print_int(dataLpn); uart_print(" in slot "); uart_print_int(slot); uart_print("\r\n");
+        readCacheLpn[slot] = INVALID;
+        readCacheValidChunks[slot] = 0;
+        readCacheRefBit[slot] = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef READ_CACHE_H
+#define READ_CACHE_H
+#include "jasmine.h"
+
+void readCacheInit();
+BOOL8 readCacheLookup(const UINT32 dataLpn, const UINT32 sectOffset, const UINT32 nSects, const UINT32 dstPageAddr);
+void readCacheInsert(const UINT32 dataLpn, const UINT32 sectOffset, const UINT32 nSects, const UINT32 srcPageAddr);
+void readCacheInvalidate(const UINT32 dataLpn);
+
+#endif
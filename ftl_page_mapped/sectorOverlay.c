@@ -0,0 +1,187 @@
+#include "sectorOverlay.h"
+#include "ftl_metadata.h"
+#include "ftl_parameters.h"
+#include "dram_layout.h"
+#include "log.h" // findChunkLocation
+#include "read.h" // rebuildPageToFtlBuf
+#include "write.h" // writeMergedChunk
+#include "chunksMap.h" // getChunkAddr
+
+/* Sector-granular overlay of the chunks map.
+ * A write smaller than a chunk, to a chunk stored in flash, does not read the old chunk: its sectors are kept in an
+ * overlay slot, a chunk-sized buffer in the SECTOR_OVERLAY region of DRAM with a bitmap of the sectors it holds.
+ * The mapped chunk stays where it is, and the next small writes to the same chunk are absorbed in the same slot.
+ * The sectors of a slot are newer than the mapped chunk, so every reader of the chunk applies them on top:
+ * - the read path, after rebuilding the page in FTL_BUF;
+ * - GC, which merges them for free into the chunk it is moving anyway, and drops the slot.
+ * A slot that collects all the sectors of its chunk is written as a new chunk, without any read. A slot evicted by
+ * the CLOCK policy, or flushed by ftl_flush, is merged with a read-modify-write into the cold log.
+ * Writes of whole chunks and trims drop the slot. */
+
+#if OPTION_SECTOR_OVERLAY
+
+#define FullChunkSectors    ((UINT32)((1ULL << SECTORS_PER_CHUNK) - 1))
+#define OverlayKey(lpn, chunkIdx)   ((lpn) * CHUNKS_PER_PAGE + (chunkIdx))
+
+static UINT32 overlayKey[NUM_OVERLAY_SLOTS]; // lpn and chunk index, INVALID if the slot is free
+static UINT32 overlaySectors[NUM_OVERLAY_SLOTS]; // bitmap of the sectors held in the slot
+static UINT8 overlayRefBit[NUM_OVERLAY_SLOTS];
+static UINT32 clockHand;
+
+static UINT32 findSlot(const UINT32 lpn, const UINT32 chunkIdx)
+{
+    return mem_search_equ_sram_4_bytes(overlayKey, NUM_OVERLAY_SLOTS, OverlayKey(lpn, chunkIdx));
+}
+
+static void copySectors(const UINT32 dstChunkAddr, const UINT32 srcChunkAddr, const UINT32 sectors)
+{
+    for (UINT32 sect=0; sect<SECTORS_PER_CHUNK; sect++)
+    {
+        if (sectors & ((UINT32)1 << sect))
+        {
+            mem_copy(dstChunkAddr + (sect * BYTES_PER_SECTOR), srcChunkAddr + (sect * BYTES_PER_SECTOR), BYTES_PER_SECTOR);
+        }
+    }
+}
+
+static void freeSlot(const UINT32 slot)
+{
+    overlayKey[slot] = INVALID;
+    overlaySectors[slot] = 0;
+    overlayRefBit[slot] = 0;
+}
+
+// The chunk goes to the cold log of the bank holding its old copy
+static UINT32 mergeBank(const UINT32 lpn, const UINT32 chunkIdx)
+{
+    UINT32 oldChunkAddr = getChunkAddr(lpn, chunkIdx);
+    if (oldChunkAddr == INVALID)
+    {
+        return 0;
+    }
+    return ChunkToBank(oldChunkAddr & ~(ColdLogBufBitFlag));
+}
+
+// Read-modify-write of the slot into the cold log
+static void mergeSlot(const UINT32 slot)
+{
+    UINT32 lpn = overlayKey[slot] / CHUNKS_PER_PAGE;
+    UINT32 chunkIdx = overlayKey[slot] % CHUNKS_PER_PAGE;
+    uart_print("sectorOverlay mergeSlot: slot "); uart_print_int(slot); uart_print(" lpn "); uart_print_int(lpn); uart_print(" chunk "); uart_print_int(chunkIdx); uart_print("\r\n");
+    rebuildPageToFtlBuf(lpn, chunkIdx * SECTORS_PER_CHUNK, SECTORS_PER_CHUNK, ReadMode); // the overlay is applied here
+    freeSlot(slot);
+    writeMergedChunk(mergeBank(lpn, chunkIdx), lpn, chunkIdx, FTL_BUF(0) + (chunkIdx * BYTES_PER_CHUNK));
+}
+
+static UINT32 clockVictim()
+{
+    while (overlayRefBit[clockHand] == 1)
+    {
+        overlayRefBit[clockHand] = 0;
+        clockHand = (clockHand + 1) % NUM_OVERLAY_SLOTS;
+    }
+    UINT32 victim = clockHand;
+    clockHand = (clockHand + 1) % NUM_OVERLAY_SLOTS;
+    return victim;
+}
+
+void sectorOverlayInit()
+{
+    uart_print("sectorOverlayInit: slots = "); uart_print_int(NUM_OVERLAY_SLOTS); uart_print("\r\n");
+    for (UINT32 slot=0; slot<NUM_OVERLAY_SLOTS; slot++)
+    {
+        freeSlot(slot);
+    }
+    clockHand = 0;
+}
+
+// Returns TRUE if the sectors were kept in the overlay, FALSE if the caller must write them in the log
+BOOL8 sectorOverlayAbsorb(const UINT32 lpn, const UINT32 chunkIdx, const UINT32 oldChunkAddr, const UINT32 sectInChunk, const UINT32 nSects, const UINT32 srcChunkAddr)
+{
+    UINT32 slot = findSlot(lpn, chunkIdx);
+    if (slot >= NUM_OVERLAY_SLOTS)
+    {
+        UINT32 location = findChunkLocation(oldChunkAddr);
+        if (location != FlashWLog && location != FlashWLogEncoded)
+        { // nothing to read for the merge
+            return FALSE;
+        }
+        slot = mem_search_equ_sram_4_bytes(overlayKey, NUM_OVERLAY_SLOTS, INVALID);
+        if (slot >= NUM_OVERLAY_SLOTS)
+        {
+            slot = clockVictim();
+            mergeSlot(slot);
+        }
+        overlayKey[slot] = OverlayKey(lpn, chunkIdx);
+        overlaySectors[slot] = 0;
+    }
+    uart_print("sectorOverlayAbsorb: lpn "); uart_print_int(lpn); uart_print(" chunk "); uart_print_int(chunkIdx); uart_print(" in slot "); uart_print_int(slot); uart_print("\r\n");
+    UINT32 sectors = (((UINT32)1 << nSects) - 1) << sectInChunk;
+    copySectors(OverlayBuf(slot), srcChunkAddr, sectors);
+    overlaySectors[slot] |= sectors;
+    overlayRefBit[slot] = 1;
+    if (overlaySectors[slot] == FullChunkSectors)
+    { // the whole chunk was rewritten in small pieces: no read is needed
+        uart_print("sectorOverlayAbsorb: slot "); uart_print_int(slot); uart_print(" is complete\r\n");
+        UINT32 bank = mergeBank(lpn, chunkIdx);
+        freeSlot(slot);
+        writeMergedChunk(bank, lpn, chunkIdx, OverlayBuf(slot));
+    }
+    return TRUE;
+}
+
+void sectorOverlayApply(const UINT32 lpn, const UINT32 chunkIdx, const UINT32 dstChunkAddr)
+{
+    UINT32 slot = findSlot(lpn, chunkIdx);
+    if (slot < NUM_OVERLAY_SLOTS)
+    {
+        copySectors(dstChunkAddr, OverlayBuf(slot), overlaySectors[slot]);
+    }
+}
+
+// For GC: the chunk being moved takes the sectors of the overlay, which is no longer needed
+void sectorOverlayMergeInto(const UINT32 lpn, const UINT32 chunkIdx, const UINT32 dstChunkAddr)
+{
+    UINT32 slot = findSlot(lpn, chunkIdx);
+    if (slot < NUM_OVERLAY_SLOTS)
+    {
+        uart_print("sectorOverlayMergeInto: lpn "); uart_print_int(lpn); uart_print(" chunk "); uart_print_int(chunkIdx); uart_print("\r\n");
+        copySectors(dstChunkAddr, OverlayBuf(slot), overlaySectors[slot]);
+        freeSlot(slot);
+    }
+}
+
+void sectorOverlayDrop(const UINT32 lpn, const UINT32 chunkIdx)
+{
+    UINT32 slot = findSlot(lpn, chunkIdx);
+    if (slot < NUM_OVERLAY_SLOTS)
+    {
+        uart_print("sectorOverlayDrop: lpn "); uart_print_int(lpn); uart_print(" chunk "); uart_print_int(chunkIdx); uart_print("\r\n");
+        freeSlot(slot);
+    }
+}
+
+BOOL8 sectorOverlayHasLpn(const UINT32 lpn)
+{
+    for (UINT32 chunkIdx=0; chunkIdx<CHUNKS_PER_PAGE; chunkIdx++)
+    {
+        if (findSlot(lpn, chunkIdx) < NUM_OVERLAY_SLOTS)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+void sectorOverlayFlush()
+{
+    for (UINT32 slot=0; slot<NUM_OVERLAY_SLOTS; slot++)
+    {
+        if (overlayKey[slot] != INVALID)
+        {
+            mergeSlot(slot);
+        }
+    }
+}
+
+#endif
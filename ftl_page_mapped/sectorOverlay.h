@@ -0,0 +1,13 @@
+#ifndef SECTOR_OVERLAY_H
+#define SECTOR_OVERLAY_H
+#include "jasmine.h"
+
+void sectorOverlayInit();
+BOOL8 sectorOverlayAbsorb(const UINT32 lpn, const UINT32 chunkIdx, const UINT32 oldChunkAddr, const UINT32 sectInChunk, const UINT32 nSects, const UINT32 srcChunkAddr);
+void sectorOverlayApply(const UINT32 lpn, const UINT32 chunkIdx, const UINT32 dstChunkAddr);
+void sectorOverlayMergeInto(const UINT32 lpn, const UINT32 chunkIdx, const UINT32 dstChunkAddr);
+void sectorOverlayDrop(const UINT32 lpn, const UINT32 chunkIdx);
+BOOL8 sectorOverlayHasLpn(const UINT32 lpn);
+void sectorOverlayFlush();
+
+#endif
@@ -0,0 +1,114 @@
+#include "temperature.h"
+#include "ftl_metadata.h"
+#include "ftl_parameters.h"
+#include "dram_layout.h"
+
+/* Update-frequency detector for the chunks written by the host, with multiple bloom filters.
+ * Every chunk write is recorded in one of NUM_TEMPERATURE_FILTERS filters: the current one, or if the chunk is already
+ * there, the most recent filter that does not have it yet. The temperature of a chunk is the number of filters that
+ * contain it, so it grows with both the frequency and the recency of its updates.
+ * After temperatureDecayWrites recorded writes the oldest filter is cleared and becomes the current one, which makes
+ * the chunks that stop being written cool down.
+ * A false positive of the filters can only make a chunk look hotter than it is. Each filter is sized for the writes of
+ * its decay window at about 16 bits per write, with TEMPERATURE_FILTER_HASHES bits per write (double hashing): the
+ * filters are too big for SRAM and are kept in DRAM. */
+
+#if OPTION_TEMPERATURE_DETECTOR
+
+#define FilterBits          (1 << TEMPERATURE_FILTER_BITS_LOG2)
+#define FilterBytes         (FilterBits / 8)
+#define TemperatureKey(lpn, chunkIdx)   ((lpn) * CHUNKS_PER_PAGE + (chunkIdx))
+
+static UINT32 currentFilter;
+static UINT32 writesInCurrentFilter;
+
+static UINT32 hash1(const UINT32 key)
+{
+    return (key * 2654435761u) >> (32 - TEMPERATURE_FILTER_BITS_LOG2);
+}
+
+static UINT32 hash2(const UINT32 key)
+{
+    return ((key ^ (key >> 16)) * 0x85EBCA6Bu) >> (32 - TEMPERATURE_FILTER_BITS_LOG2);
+}
+
+static BOOL8 filterHas(const UINT32 filter, const UINT32 key)
+{
+    UINT32 h1 = hash1(key);
+    UINT32 h2 = hash2(key);
+    for (UINT32 i=0; i<TEMPERATURE_FILTER_HASHES; i++)
+    {
+        if (!tst_bit_dram(TemperatureFilter(filter), (h1 + i * h2) & (FilterBits - 1)))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void filterAdd(const UINT32 filter, const UINT32 key)
+{
+    UINT32 h1 = hash1(key);
+    UINT32 h2 = hash2(key);
+    for (UINT32 i=0; i<TEMPERATURE_FILTER_HASHES; i++)
+    {
+        set_bit_dram(TemperatureFilter(filter), (h1 + i * h2) & (FilterBits - 1));
+    }
+}
+
+static void decay()
+{
+    currentFilter = (currentFilter + 1) % NUM_TEMPERATURE_FILTERS;
+    uart_print("temperature decay: clearing filter "); uart_print_int(currentFilter); uart_print("\r\n");
+    mem_set_dram(TemperatureFilter(currentFilter), 0, FilterBytes);
+    writesInCurrentFilter = 0;
+}
+
+void temperatureInit()
+{
+    uart_print("temperatureInit: filters = "); uart_print_int(NUM_TEMPERATURE_FILTERS); uart_print("\r\n");
+    mem_set_dram(TEMPERATURE_FILTERS_ADDR, 0, TEMPERATURE_FILTERS_BYTES);
+    currentFilter = 0;
+    writesInCurrentFilter = 0;
+}
+
+void temperatureRecordWrite(const UINT32 lpn, const UINT32 chunkIdx)
+{
+    UINT32 key = TemperatureKey(lpn, chunkIdx);
+    for (UINT32 age=0; age<NUM_TEMPERATURE_FILTERS; age++)
+    {
+        UINT32 filter = (currentFilter + NUM_TEMPERATURE_FILTERS - age) % NUM_TEMPERATURE_FILTERS;
+        if (!filterHas(filter, key))
+        {
+            filterAdd(filter, key);
+            break;
+        }
+    }
+    writesInCurrentFilter++;
+    if (writesInCurrentFilter >= temperatureDecayWrites)
+    {
+        decay();
+    }
+}
+
+// Number of filters that contain the chunk, from 0 (never written recently) to NUM_TEMPERATURE_FILTERS.
+UINT32 temperatureOf(const UINT32 lpn, const UINT32 chunkIdx)
+{
+    UINT32 key = TemperatureKey(lpn, chunkIdx);
+    UINT32 temperature = 0;
+    for (UINT32 filter=0; filter<NUM_TEMPERATURE_FILTERS; filter++)
+    {
+        if (filterHas(filter, key))
+        {
+            temperature++;
+        }
+    }
+    return temperature;
+}
+
+BOOL8 temperatureIsHot(const UINT32 lpn, const UINT32 chunkIdx)
+{
+    return temperatureOf(lpn, chunkIdx) >= temperatureHotThreshold;
+}
+
+#endif
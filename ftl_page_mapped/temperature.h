@@ -0,0 +1,10 @@
+#ifndef TEMPERATURE_H
+#define TEMPERATURE_H
+#include "jasmine.h"
+
+void temperatureInit();
+void temperatureRecordWrite(const UINT32 lpn, const UINT32 chunkIdx);
+UINT32 temperatureOf(const UINT32 lpn, const UINT32 chunkIdx);
+BOOL8 temperatureIsHot(const UINT32 lpn, const UINT32 chunkIdx);
+
+#endif
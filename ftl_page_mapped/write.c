@@ -8,6 +8,11 @@
 #include "read.h" // rebuildPageToFtlBuf
 #include "write.h"
 #include "cleanList.h" // cleanListSize
+#include "readCache.h"
+#include "readAhead.h"
+#include "chunksMap.h"
+#include "pendingMerge.h"
+#include "sectorOverlay.h"
 
 #if WOMCanFail
 #include "stdlib.h"
@@ -39,10 +44,14 @@ static void writePartialChunkWhenOldChunkIsInFlashLog(UINT32 nSectsToWrite, UINT
 static void writePartialChunkWhenOldChunkIsInFlashLogEncoded(UINT32 nSectsToWrite, UINT32 oldChunkAddr);
 
 #if WOMCanFail
+static void retryReuseBufOnNextPage();
 static void copyReuseBufToColdBuf();
 #endif
 
 // Data members
+#if WOMCanFail
+static UINT32 womRetries[NUM_BANKS]; // consecutive failed WOM programs of the chunks in the hot buffer of the bank
+#endif
 static UINT32 bank_;
 static LogCtrlBlock * ctrlBlock_;
 static UINT32 lpn_;
@@ -50,6 +59,35 @@ static UINT32 sectOffset_;
 static UINT32 nSects_;
 static UINT32 remainingSects_;
 
+/* With OPTION_DOUBLE_LOG_BUFFERS every log of every bank has two DRAM buffers. A log page is programmed from the
+ * buffer just filled, while the next chunks are copied into the other one, so copying a chunk never waits for a
+ * program to complete. Instead we wait for the bank before issuing a program: the previous program, from the
+ * other buffer, is then done before that buffer becomes the active one again. */
+static void waitLogBufferFree(const UINT32 bank)
+{
+#if OPTION_DOUBLE_LOG_BUFFERS == 0
+    waitBusyBank(bank);
+#endif
+}
+
+static void programLogBuffer(LogCtrlBlock * ctrlBlock, const UINT32 bank, const UINT32 vBlk, const UINT32 pageOffset)
+{
+#if OPTION_ASYNC_RMW
+    pendingMergeComplete(ctrlBlock[bank].logBufferAddr, BYTES_PER_PAGE);
+#endif
+#if OPTION_LOG_STREAMS
+    write_dram_8(LogBlkStream(bank, LogPageToLogBlk(ctrlBlock[bank].logLpn)), ctrlBlock[bank].stream);
+#endif
+#if OPTION_DOUBLE_LOG_BUFFERS
+    waitBusyBank(bank);
+    nand_page_program(bank, vBlk, pageOffset, ctrlBlock[bank].logBufferAddr, RETURN_ON_ISSUE);
+    UINT32 firstBuf = (ctrlBlock == hotLogCtrl) ? HOT_LOG_BUF(bank) : COLD_STREAM_LOG_BUF(ctrlBlock[bank].stream, bank);
+    ctrlBlock[bank].logBufferAddr = (ctrlBlock[bank].logBufferAddr == firstBuf) ? SECOND_LOG_BUF(firstBuf) : firstBuf;
+#else
+    nand_page_program(bank, vBlk, pageOffset, ctrlBlock[bank].logBufferAddr, RETURN_ON_ISSUE);
+#endif
+}
+
 static void flushLogBuffer()
 {
 
@@ -67,7 +105,7 @@ static void flushLogBuffer()
     UINT32 chunksToFlush=CHUNKS_PER_PAGE;
     UINT32 lChunkAddr = (bank_ * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + (newLogLpn * CHUNKS_PER_PAGE);
 
-    nand_page_program(bank_, vBlk, pageOffset, ctrlBlock_[bank_].logBufferAddr, RETURN_ON_ISSUE);
+    programLogBuffer(ctrlBlock_, bank_, vBlk, pageOffset);
 
     if( __builtin_expect(ctrlBlock_[bank_].allChunksInLogAreValid, TRUE))
     {
@@ -75,7 +113,7 @@ static void flushLogBuffer()
 
         for(int i=0; i<chunksToFlush; i++)
         {
-            write_dram_32(ChunksMapTable(ctrlBlock_[bank_].dataLpn[i], ctrlBlock_[bank_].chunkIdx[i]), lChunkAddr);
+            setChunkAddr(ctrlBlock_[bank_].dataLpn[i], ctrlBlock_[bank_].chunkIdx[i], lChunkAddr);
             lChunkAddr++;
         }
     }
@@ -88,13 +126,16 @@ static void flushLogBuffer()
 
             if (ctrlBlock_[bank_].dataLpn[i] != INVALID)
             {
-                write_dram_32(ChunksMapTable(ctrlBlock_[bank_].dataLpn[i], ctrlBlock_[bank_].chunkIdx[i]), lChunkAddr);
+                setChunkAddr(ctrlBlock_[bank_].dataLpn[i], ctrlBlock_[bank_].chunkIdx[i], lChunkAddr);
             }
             else
             {
                 decrementValidChunks(&heapDataFirstUsage, bank_, LogPageToLogBlk(newLogLpn)); // decrement blk with previous copy
                 decrementValidChunks(&heapDataSecondUsage, bank_, LogPageToLogBlk(newLogLpn)); // decrement blk with previous copy
                 decrementValidChunks(&heapDataCold, bank_, LogPageToLogBlk(newLogLpn)); // decrement blk with previous copy
+#if OPTION_PAGE_VALID_SUMMARY
+                clearChunkValidSummary(lChunkAddr);
+#endif
             }
             lChunkAddr++;
         }
@@ -113,16 +154,29 @@ static void flushLogBufferRecycledPage()
     }
 #endif
 
+#if OPTION_ASYNC_RELOCATION
+    commitResidualRelocation(bank_); // the residual valid chunks must leave the page before it is reprogrammed
+#endif
+
 #if WOMCanFail
     if (successRateWOM < 100.0)
     {
         float r = (float)rand() / (float) (RAND_MAX/100.0);
         if (r >= successRateWOM)
         {
-            copyReuseBufToColdBuf();
+            if (womRetries[bank_] < womMaxRetries)
+            {
+                retryReuseBufOnNextPage();
+            }
+            else
+            {
+                womRetries[bank_] = 0;
+                copyReuseBufToColdBuf();
+            }
             return;
         }
     }
+    womRetries[bank_] = 0;
 #endif
 
 #if PrintStats
@@ -159,14 +213,17 @@ static void flushLogBufferRecycledPage()
     //uart_print_level_1_int(pageOffset);
     //uart_print_level_1("\r\n");
 
-    nand_page_program(bank_, vBlk, pageOffset, ctrlBlock_[bank_].logBufferAddr, RETURN_ON_ISSUE);
+    programLogBuffer(ctrlBlock_, bank_, vBlk, pageOffset);
+#if OPTION_PRECACHE_RING
+    popPrecachedLowPage(bank_);
+#endif
 
     if( __builtin_expect(ctrlBlock_[bank_].allChunksInLogAreValid, TRUE))
     {
 
         for(int i=0; i<chunksToFlush; i++)
         {
-            write_dram_32(ChunksMapTable(ctrlBlock_[bank_].dataLpn[i], ctrlBlock_[bank_].chunkIdx[i]), lChunkAddr);
+            setChunkAddr(ctrlBlock_[bank_].dataLpn[i], ctrlBlock_[bank_].chunkIdx[i], lChunkAddr);
             ctrlBlock_[bank_].dataLpn[i] |= ColdLogBufBitFlag; // Set 31st bit in the inverse map so that during GC we know that these chunks were encoded
             lChunkAddr++;
         }
@@ -182,7 +239,7 @@ static void flushLogBufferRecycledPage()
 
             if (ctrlBlock_[bank_].dataLpn[i] != INVALID)
             {
-                write_dram_32(ChunksMapTable(ctrlBlock_[bank_].dataLpn[i], ctrlBlock_[bank_].chunkIdx[i]), lChunkAddr);
+                setChunkAddr(ctrlBlock_[bank_].dataLpn[i], ctrlBlock_[bank_].chunkIdx[i], lChunkAddr);
                 validChunks++;
             }
 
@@ -198,43 +255,75 @@ static void flushLogBufferRecycledPage()
 }
 
 #if WOMCanFail
+/* A failed WOM program leaves the low page with its old content, so the chunks stay in the hot buffer and the page is
+ * given up: it was credited with CHUNKS_PER_PAGE valid chunks by canReuseLowPage (the residual ones have been
+ * relocated already), and none of them is valid now.
+ * The next page of the block gets the chunks. A high page always takes them, as the first half of a normal page; a low
+ * page reusable in turn is a new WOM attempt on different cell states, issued right away since the buffer is full. */
+static void retryReuseBufOnNextPage()
+{
+    UINT32 lbn = LogPageToLogBlk(ctrlBlock_[bank_].logLpn);
+#if PrintStats
+    uart_print_level_1("WOMRETRY\r\n");
+#endif
+    uart_print("retryReuseBufOnNextPage bank "); uart_print_int(bank_);
+    uart_print(" gives up pageOffset "); uart_print_int(LogPageToOffset(ctrlBlock_[bank_].logLpn)); uart_print("\r\n");
+
+    womRetries[bank_]++;
+    decrementValidChunksByN(&heapDataSecondUsage, bank_, lbn, CHUNKS_PER_PAGE);
+#if OPTION_PRECACHE_RING
+    popPrecachedLowPage(bank_);
+#endif
+    ctrlBlock_[bank_].increaseLpn(bank_, ctrlBlock_); // a low page is never the last one of the block
+
+    if (ctrlBlock_[bank_].useRecycledPage)
+    {
+        flushLogBufferRecycledPage();
+    }
+    else
+    {
+        womRetries[bank_] = 0;
+        ctrlBlock_[bank_].chunkPtr = CHUNKS_PER_RECYCLED_PAGE;
+    }
+}
+
 static void copyReuseBufToColdBuf()
 {
     ctrlBlock_ = coldLogCtrl; // IMPORTANT: we're calling updateChunkPtr and this updated ctrlBlock_, so this must be
                               // coldlogctrl because this is where we're copying the chunks now.
+#if OPTION_ASYNC_RMW
+    pendingMergeComplete(hotLogCtrl[bank_].logBufferAddr, BYTES_PER_PAGE);
+#endif
 
-    /* TODO(fabio): The following code should take care of the case in which the entire reuse buffer is full and we copy it to the
-     * cold buffer in one mem_copy.
-     * For some reason it doesn't work.
-     * The error we observe is that, when the reused blk will be GCed, the GC finds 1 valid chunks while the heap was expecting 3.
+#if PrintStats
+    uart_print_level_1("WOMCOLD\r\n");
+#endif
+    /* When all the chunks are valid and fit in the cold buffer they are copied in one mem_copy. They must all fit before
+     * the last updateChunkPtr, which may program the cold buffer: the bulk copy used to be tried when the cold buffer
+     * had less room than the chunks, so they spilled past it and the map pointed the last ones to slots of the next
+     * page, which made GC find fewer valid chunks than the heap expected. */
     if((hotLogCtrl[bank_].allChunksInLogAreValid == TRUE) &&
-       (CHUNKS_PER_PAGE - coldLogCtrl[bank_].chunkPtr < CHUNKS_PER_RECYCLED_PAGE))
-    { // The chunks fit the cold buffer. Possibly triggering GC at the end.
+       (coldLogCtrl[bank_].chunkPtr + CHUNKS_PER_RECYCLED_PAGE <= CHUNKS_PER_PAGE))
+    {
         UINT32 src = hotLogCtrl[bank_].logBufferAddr;
         UINT32 dst = coldLogCtrl[bank_].logBufferAddr+(coldLogCtrl[bank_].chunkPtr*BYTES_PER_CHUNK);
         mem_copy(dst, src, CHUNKS_PER_RECYCLED_PAGE * BYTES_PER_CHUNK);
 
         for (UINT32 chunk=0; chunk<CHUNKS_PER_RECYCLED_PAGE; ++chunk)
         {
-            if (hotLogCtrl[bank_].dataLpn[chunk] == INVALID)
-            {
-                uart_print_level_1("ERROR1!!!\r\n");
-                while(1);
-            }
             UINT32 lpn = hotLogCtrl[bank_].dataLpn[chunk];
             UINT32 chunkIdx = hotLogCtrl[bank_].chunkIdx[chunk];
-            write_dram_32(ChunksMapTable(lpn, chunkIdx),
-                          (((bank_ * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) +
-                            (DramLogBufLpn * CHUNKS_PER_PAGE) +
-                            coldLogCtrl[bank_].chunkPtr) | StartOwLogLpn));
-            coldLogCtrl[bank_].dataLpn[coldLogCtrl[bank_].chunkPtr]= lpn;
-            coldLogCtrl[bank_].chunkIdx[coldLogCtrl[bank_].chunkPtr]= chunkIdx;
+            coldLogCtrl[bank_].dataLpn[coldLogCtrl[bank_].chunkPtr] = lpn;
+            coldLogCtrl[bank_].chunkIdx[coldLogCtrl[bank_].chunkPtr] = chunkIdx;
+            setChunkAddr(lpn, chunkIdx,
+                         (((bank_ * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) +
+                           (DramLogBufLpn * CHUNKS_PER_PAGE) +
+                           coldLogCtrl[bank_].chunkPtr) | StartOwLogLpn));
             updateChunkPtr();
         }
     }
 
     else
-    */
     { // We've got to copy one chunk at a time either because we'll trigger GC or because not all chunks are valid
         for (UINT32 chunk=0; chunk<CHUNKS_PER_RECYCLED_PAGE; ++chunk)
         {
@@ -248,10 +337,10 @@ static void copyReuseBufToColdBuf()
                 UINT32 chunkIdx = hotLogCtrl[bank_].chunkIdx[chunk];
                 coldLogCtrl[bank_].dataLpn[coldLogCtrl[bank_].chunkPtr] = lpn;
                 coldLogCtrl[bank_].chunkIdx[coldLogCtrl[bank_].chunkPtr] = chunkIdx;
-                write_dram_32(ChunksMapTable(lpn, chunkIdx),
-                              (((bank_ * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) +
-                                (DramLogBufLpn * CHUNKS_PER_PAGE) +
-                                coldLogCtrl[bank_].chunkPtr) | StartOwLogLpn));
+                setChunkAddr(lpn, chunkIdx,
+                             (((bank_ * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) +
+                               (DramLogBufLpn * CHUNKS_PER_PAGE) +
+                               coldLogCtrl[bank_].chunkPtr) | StartOwLogLpn));
                 updateChunkPtr();
             }
         }
@@ -270,46 +359,50 @@ static void flushLogBufferDuringGC(const UINT32 bank)
 #endif
 
     uart_print("flushLogBufferDuringGC bank="); uart_print_int(bank); uart_print("\r\n");
-    UINT32 newLogLpn = getRWLpn(bank, coldLogCtrl);
+    LogCtrlBlock * gcCtrl = gcLogCtrl(bank);
+    UINT32 newLogLpn = getRWLpn(bank, gcCtrl);
     uart_print("FlushLog to lpn="); uart_print_int(newLogLpn); uart_print("\r\n");
     UINT32 vBlk = get_log_vbn(bank, LogPageToLogBlk(newLogLpn));
     UINT32 pageOffset = LogPageToOffset(newLogLpn);
-    nand_page_program(bank, vBlk, pageOffset, coldLogCtrl[bank].logBufferAddr, RETURN_ON_ISSUE);
+    programLogBuffer(gcCtrl, bank, vBlk, pageOffset);
 
-    if (__builtin_expect(coldLogCtrl[bank].allChunksInLogAreValid, TRUE))
+    if (__builtin_expect(gcCtrl[bank].allChunksInLogAreValid, TRUE))
     {
-        mem_copy(chunkInLpnsList(coldLogCtrl[bank].lpnsListAddr, LogPageToOffset(newLogLpn), 0), coldLogCtrl[bank].dataLpn, CHUNKS_PER_PAGE * sizeof(UINT32));
+        mem_copy(chunkInLpnsList(gcCtrl[bank].lpnsListAddr, LogPageToOffset(newLogLpn), 0), gcCtrl[bank].dataLpn, CHUNKS_PER_PAGE * sizeof(UINT32));
         UINT32 lChunkAddr = (newLogLpn * CHUNKS_PER_PAGE);
         for(int i=0; i<CHUNKS_PER_PAGE; i++)
         {
-            write_dram_32(ChunksMapTable(coldLogCtrl[bank].dataLpn[i], coldLogCtrl[bank].chunkIdx[i]),
-                          (bank * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + lChunkAddr);
+            setChunkAddr(gcCtrl[bank].dataLpn[i], gcCtrl[bank].chunkIdx[i],
+                         (bank * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + lChunkAddr);
             lChunkAddr++;
         }
     }
 
     else
     {
-        mem_copy(chunkInLpnsList(coldLogCtrl[bank].lpnsListAddr, LogPageToOffset(newLogLpn), 0), coldLogCtrl[bank].dataLpn, CHUNKS_PER_PAGE * sizeof(UINT32));
+        mem_copy(chunkInLpnsList(gcCtrl[bank].lpnsListAddr, LogPageToOffset(newLogLpn), 0), gcCtrl[bank].dataLpn, CHUNKS_PER_PAGE * sizeof(UINT32));
         UINT32 lChunkAddr = (newLogLpn * CHUNKS_PER_PAGE);
         for(int i=0; i<CHUNKS_PER_PAGE; i++)
         {
-            if (coldLogCtrl[bank].dataLpn[i] != INVALID)
+            if (gcCtrl[bank].dataLpn[i] != INVALID)
             {
-                write_dram_32(ChunksMapTable(coldLogCtrl[bank].dataLpn[i], coldLogCtrl[bank].chunkIdx[i]),
-                              (bank * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + lChunkAddr);
+                setChunkAddr(gcCtrl[bank].dataLpn[i], gcCtrl[bank].chunkIdx[i],
+                             (bank * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + lChunkAddr);
             }
             else
             {
                 decrementValidChunks(&heapDataFirstUsage, bank, LogPageToLogBlk(newLogLpn));
                 decrementValidChunks(&heapDataSecondUsage, bank, LogPageToLogBlk(newLogLpn));
                 decrementValidChunks(&heapDataCold, bank, LogPageToLogBlk(newLogLpn));
+#if OPTION_PAGE_VALID_SUMMARY
+                clearChunkValidSummary((bank * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + lChunkAddr);
+#endif
             }
             lChunkAddr++;
         }
-        coldLogCtrl[bank].allChunksInLogAreValid = TRUE;
+        gcCtrl[bank].allChunksInLogAreValid = TRUE;
     }
-    coldLogCtrl[bank].increaseLpn(bank, coldLogCtrl);
+    gcCtrl[bank].increaseLpn(bank, gcCtrl);
 }
 
 void writeChunkOnLogBlockDuringGC( const UINT32 bank,
@@ -322,22 +415,38 @@ void writeChunkOnLogBlockDuringGC( const UINT32 bank,
     uart_print("writeChunkOnLogBlockDuringGC, bank="); uart_print_int(bank); uart_print(" dataLpn="); uart_print_int(dataLpn);
     uart_print(", dataChunkOffset="); uart_print_int(dataChunkOffset); uart_print("\r\n");
     int sectOffset = dataChunkOffset * SECTORS_PER_CHUNK;
+    LogCtrlBlock * gcCtrl = gcLogCtrl(bank);
     UINT32 src = bufAddr + (chunkOffsetInBuf * BYTES_PER_CHUNK);
-    UINT32 dst = coldLogCtrl[bank].logBufferAddr + (coldLogCtrl[bank].chunkPtr * BYTES_PER_CHUNK); // base address of the destination chunk
+    UINT32 dst = gcCtrl[bank].logBufferAddr + (gcCtrl[bank].chunkPtr * BYTES_PER_CHUNK); // base address of the destination chunk
     waitBusyBank(bank);
     mem_copy(dst, src, BYTES_PER_CHUNK);
+#if OPTION_SECTOR_OVERLAY
+    sectorOverlayMergeInto(dataLpn, dataChunkOffset, dst);
+#endif
     updateDramBufMetadataDuringGc(bank, dataLpn, sectOffset);
     updateChunkPtrDuringGC(bank);
 }
 
+/* Appends a whole chunk built outside the SATA buffers, i.e. a merged sector overlay, to the cold stream that receives
+ * the GC relocations of the bank.
+ * The previous copy of the chunk is invalidated as for a complete page write. */
+void writeMergedChunk(const UINT32 bank, const UINT32 dataLpn, const UINT32 chunkIdx, const UINT32 srcChunkAddr)
+{
+    uart_print("writeMergedChunk bank="); uart_print_int(bank); uart_print(" dataLpn="); uart_print_int(dataLpn);
+    uart_print(" chunkIdx="); uart_print_int(chunkIdx); uart_print("\r\n");
+    manageOldChunkForCompletePageWrite(getChunkAddr(dataLpn, chunkIdx));
+    writeChunkOnLogBlockDuringGC(bank, dataLpn, chunkIdx, 0, srcChunkAddr);
+}
+
 static void updateDramBufMetadataDuringGc(const UINT32 bank, const UINT32 lpn, const UINT32 sectOffset)
 {
     uart_print("updateDramBufMetadataDuringGc\r\n");
+    LogCtrlBlock * gcCtrl = gcLogCtrl(bank);
     UINT32 chunkIdx = sectOffset / SECTORS_PER_CHUNK;
-    coldLogCtrl[bank].dataLpn[coldLogCtrl[bank].chunkPtr]=lpn;
-    coldLogCtrl[bank].chunkIdx[coldLogCtrl[bank].chunkPtr]=chunkIdx;
-    write_dram_32(ChunksMapTable(lpn, chunkIdx),
-                  (((bank * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + (DramLogBufLpn * CHUNKS_PER_PAGE) + coldLogCtrl[bank].chunkPtr) | StartOwLogLpn));
+    gcCtrl[bank].dataLpn[gcCtrl[bank].chunkPtr]=lpn;
+    gcCtrl[bank].chunkIdx[gcCtrl[bank].chunkPtr]=chunkIdx;
+    setChunkAddr(lpn, chunkIdx,
+                 (((bank * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + (ColdStreamBufLpn(gcCtrl[bank].stream) * CHUNKS_PER_PAGE) + gcCtrl[bank].chunkPtr) | StartOwLogLpn));
 }
 
 /*
@@ -376,9 +485,63 @@ UINT32 chooseNewBank()
     return(candidateBank);
 }
 */
-UINT32 chooseNewBank(UINT32 chunkNumber)
+/* Load-aware choice of the bank for the next logical page write.
+ * Banks are compared in order of: flash idle (otherwise the write waits in waitBusyBank), log buffer able to
+ * absorb the chunks without a flush (complete pages always go to flash), number of clean blocks (less GC ahead),
+ * number of idle banks on the same channel. The scan follows the striping order (stripeBank) starting after
+ * the last chosen bank, so that equivalent banks are used round robin across the channels. */
+static UINT32 lastChosenPos = NUM_BANKS - 1;
+UINT32 chooseNewBank(LogCtrlBlock * ctrlBlock, const UINT32 sectOffset, const UINT32 nSects)
 {
-    return (chunkNumber % NUM_BANKS);
+    UINT32 nChunks = ((sectOffset + nSects + SECTORS_PER_CHUNK - 1) / SECTORS_PER_CHUNK) - (sectOffset / SECTORS_PER_CHUNK);
+    UINT32 busyBanks = 0;
+    UINT32 busyInChannel[NUM_CHANNELS];
+    for (UINT32 channel=0; channel<NUM_CHANNELS; channel++)
+    {
+        busyInChannel[channel] = 0;
+    }
+    for (UINT32 bank=0; bank<NUM_BANKS; bank++)
+    {
+        if (isBankBusy(bank))
+        {
+            busyBanks |= (UINT32)1 << bank;
+            busyInChannel[BankToChannel(bank)]++;
+        }
+    }
+
+    UINT32 bestBank = INVALID;
+    UINT32 bestPos = 0;
+    UINT32 bestIdle = 0;
+    UINT32 bestRoom = 0;
+    UINT32 bestClean = 0;
+    UINT32 bestChannelIdle = 0;
+    for (UINT32 i=1; i<=NUM_BANKS; i++)
+    {
+        UINT32 pos = (lastChosenPos + i) % NUM_BANKS;
+        UINT32 bank = stripeBank[pos];
+        UINT32 idle = (busyBanks & ((UINT32)1 << bank)) ? 0 : 1;
+        UINT32 chunksInBuf = ctrlBlock[bank].useRecycledPage ? CHUNKS_PER_RECYCLED_PAGE : CHUNKS_PER_PAGE;
+        UINT32 room = (nSects == SECTORS_PER_PAGE || ctrlBlock[bank].chunkPtr + nChunks < chunksInBuf) ? 1 : 0;
+        UINT32 clean = cleanListSize(&cleanListDataWrite, bank);
+        UINT32 channelIdle = WAYS_PER_CHANNEL - busyInChannel[BankToChannel(bank)];
+        if (bestBank == INVALID ||
+            idle > bestIdle ||
+            (idle == bestIdle && room > bestRoom) ||
+            (idle == bestIdle && room == bestRoom && clean > bestClean) ||
+            (idle == bestIdle && room == bestRoom && clean == bestClean && channelIdle > bestChannelIdle))
+        {
+            bestBank = bank;
+            bestPos = pos;
+            bestIdle = idle;
+            bestRoom = room;
+            bestClean = clean;
+            bestChannelIdle = channelIdle;
+        }
+    }
+    uart_print("chooseNewBank: bank "); uart_print_int(bestBank); uart_print(" idle "); uart_print_int(bestIdle);
+    uart_print(" room "); uart_print_int(bestRoom); uart_print(" clean "); uart_print_int(bestClean); uart_print("\r\n");
+    lastChosenPos = bestPos;
+    return bestBank;
 }
 
 
@@ -408,12 +571,6 @@ static void manageOldCompletePage()
 //static void manageOldChunkForCompletePageWrite(int chunkIdx)
 static void manageOldChunkForCompletePageWrite(const UINT32 oldChunkAddr)
 {
-#if OPTION_DEBUG_WRITE
-    if (ChunksMapTable(lpn_, chunkIdx) > DRAM_BASE + DRAM_SIZE)
-    {
-        uart_print_level_1("ERROR in manageOldChunkForCompletePageWrite 1: reading above DRAM address space\r\n");
-    }
-#endif
     //UINT32 oldChunkAddr = read_dram_32(ChunksMapTable(lpn_, chunkIdx));
     switch (findChunkLocation(oldChunkAddr))
     {
@@ -428,6 +585,9 @@ static void manageOldChunkForCompletePageWrite(const UINT32 oldChunkAddr)
             decrementValidChunks(&heapDataFirstUsage, oldChunkBank, oldChunkLbn);
             decrementValidChunks(&heapDataSecondUsage, oldChunkBank, oldChunkLbn);
             decrementValidChunks(&heapDataCold, oldChunkBank, oldChunkLbn);
+#if OPTION_PAGE_VALID_SUMMARY
+            clearChunkValidSummary(oldChunkAddr);
+#endif
 // note(fabio): insert this just to have GC tests working. Probably should disable this checks if they become too heavy
             if (oldChunkLbn == victimLbn[oldChunkBank])
             {
@@ -447,6 +607,9 @@ static void manageOldChunkForCompletePageWrite(const UINT32 oldChunkAddr)
             decrementValidChunks(&heapDataFirstUsage, oldChunkBank, oldChunkLbn);
             decrementValidChunks(&heapDataSecondUsage, oldChunkBank, oldChunkLbn);
             decrementValidChunks(&heapDataCold, oldChunkBank, oldChunkLbn);
+#if OPTION_PAGE_VALID_SUMMARY
+            clearChunkValidSummary(realOldChunkAddr);
+#endif
 // note(fabio): insert this just to have GC tests working. Probably should disable this checks if they become too heavy
             if (oldChunkLbn == victimLbn[oldChunkBank])
             {
@@ -469,8 +632,8 @@ static void manageOldChunkForCompletePageWrite(const UINT32 oldChunkAddr)
             UINT32 realOldChunkAddr = oldChunkAddr & ~(ColdLogBufBitFlag);
             uart_print("masked oldChunkAddr is "); uart_print_int(realOldChunkAddr); uart_print("\r\n");
             UINT32 oldChunkBank = ChunkToBank(realOldChunkAddr);
-            coldLogCtrl[oldChunkBank].dataLpn[realOldChunkAddr % CHUNKS_PER_PAGE]=INVALID;
-            coldLogCtrl[oldChunkBank].allChunksInLogAreValid = FALSE;
+            ColdStreamCtrlOfBufChunk(realOldChunkAddr)[oldChunkBank].dataLpn[realOldChunkAddr % CHUNKS_PER_PAGE]=INVALID;
+            ColdStreamCtrlOfBufChunk(realOldChunkAddr)[oldChunkBank].allChunksInLogAreValid = FALSE;
             return;
         }
     }
@@ -484,13 +647,13 @@ static void updateDramBufMetadata()
     ctrlBlock_[bank_].chunkIdx[ctrlBlock_[bank_].chunkPtr]=chunkIdx;
     if (ctrlBlock_ == hotLogCtrl)
     { // hot data
-        write_dram_32(ChunksMapTable(lpn_, chunkIdx),
-                      (bank_ * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + (DramLogBufLpn * CHUNKS_PER_PAGE) + ctrlBlock_[bank_].chunkPtr);
+        setChunkAddr(lpn_, chunkIdx,
+                     (bank_ * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + (DramLogBufLpn * CHUNKS_PER_PAGE) + ctrlBlock_[bank_].chunkPtr);
     }
     else
     { // cold data
-        write_dram_32(ChunksMapTable(lpn_, chunkIdx),
-                      (((bank_ * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + (DramLogBufLpn * CHUNKS_PER_PAGE) + ctrlBlock_[bank_].chunkPtr) | StartOwLogLpn));
+        setChunkAddr(lpn_, chunkIdx,
+                     (((bank_ * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + (ColdStreamBufLpn(ctrlBlock_[bank_].stream) * CHUNKS_PER_PAGE) + ctrlBlock_[bank_].chunkPtr) | StartOwLogLpn));
     }
 }
 
@@ -508,6 +671,12 @@ void updateChunkPtr()
     }
     else
     {
+#if OPTION_PRECACHE_RING
+        if (isBankBusy(bank_) == FALSE)
+        { // only hot blocks are recycled
+            precacheAheadLowPage(bank_, hotLogCtrl);
+        }
+#else
         if (ctrlBlock_[bank_].nextLowPageOffset != INVALID)
         {
             if (ctrlBlock_[bank_].precacheDone == FALSE)
@@ -518,6 +687,7 @@ void updateChunkPtr()
                 }
             }
         }
+#endif
     }
 }
 
@@ -535,6 +705,12 @@ void updateChunkPtrRecycledPage()
     }
     else
     {
+#if OPTION_PRECACHE_RING
+        if (isBankBusy(bank_) == FALSE)
+        { // only hot blocks are recycled
+            precacheAheadLowPage(bank_, hotLogCtrl);
+        }
+#else
         if (ctrlBlock_[bank_].nextLowPageOffset != INVALID)
         {
             if (ctrlBlock_[bank_].precacheDone == FALSE)
@@ -545,24 +721,149 @@ void updateChunkPtrRecycledPage()
                 }
             }
         }
+#endif
+    }
+}
+
+/* Programs the partially filled log buffer of the bank, for ftl_flush. The slots not written yet are marked invalid,
+ * as if their chunks had been overwritten, so the page is accounted like any other page with invalid chunks.
+ * Returns TRUE if the buffer held some chunks. */
+BOOL8 flushPartialLogBuffer(LogCtrlBlock * ctrlBlock, const UINT32 bank)
+{
+    if (ctrlBlock[bank].chunkPtr == 0)
+    {
+        return FALSE;
+    }
+    uart_print("flushPartialLogBuffer bank "); uart_print_int(bank); uart_print(" chunkPtr "); uart_print_int(ctrlBlock[bank].chunkPtr); uart_print("\r\n");
+
+    UINT32 chunksInBuf = ctrlBlock[bank].useRecycledPage ? CHUNKS_PER_RECYCLED_PAGE : CHUNKS_PER_PAGE;
+    for (UINT32 chunk=ctrlBlock[bank].chunkPtr; chunk<chunksInBuf; chunk++)
+    {
+        ctrlBlock[bank].dataLpn[chunk] = INVALID;
+        ctrlBlock[bank].chunkIdx[chunk] = INVALID;
+    }
+    ctrlBlock[bank].allChunksInLogAreValid = FALSE;
+    ctrlBlock[bank].chunkPtr = 0;
+
+    ctrlBlock_ = ctrlBlock;
+    bank_ = bank;
+    if (ctrlBlock[bank].useRecycledPage)
+    {
+        flushLogBufferRecycledPage();
     }
+    else
+    {
+        flushLogBuffer();
+    }
+    return TRUE;
+}
+
+/* TRUE if nChunks chunks can be appended to the GC stream of bank without flushing its log buffer, and a complete page
+ * can be programmed to it without opening a new block, which may start a GC. */
+BOOL8 gcLogHasRoom(const UINT32 bank, const UINT32 nChunks)
+{
+    LogCtrlBlock * gcCtrl = gcLogCtrl(bank);
+    return (gcCtrl[bank].chunkPtr + nChunks < CHUNKS_PER_PAGE) && (LogPageToOffset(gcCtrl[bank].logLpn) != UsedPagesPerLogBlk-1);
 }
 
 static void updateChunkPtrDuringGC(const UINT32 bank)
 {
     uart_print("updateChunkPtrDuringGC\r\n");
-    coldLogCtrl[bank].chunkPtr = (coldLogCtrl[bank].chunkPtr + 1) % CHUNKS_PER_PAGE;
-    uart_print("new chunkPtr for bank "); uart_print_int(bank); uart_print(" is "); uart_print_int(coldLogCtrl[bank].chunkPtr); uart_print("\r\n");
-    if (coldLogCtrl[bank].chunkPtr == 0)
+    LogCtrlBlock * gcCtrl = gcLogCtrl(bank);
+    gcCtrl[bank].chunkPtr = (gcCtrl[bank].chunkPtr + 1) % CHUNKS_PER_PAGE;
+    uart_print("new chunkPtr for bank "); uart_print_int(bank); uart_print(" is "); uart_print_int(gcCtrl[bank].chunkPtr); uart_print("\r\n");
+    if (gcCtrl[bank].chunkPtr == 0)
         flushLogBufferDuringGC(bank);
 }
 
+#if OPTION_SYNC_IDLE_WORK
+/* Cooperative work done while waiting for the host to transfer the sectors of a partial page write.
+ * Every call does at most one unit of work, that is at most one flash command, so that the transfer is checked
+ * again soon: precaching a low page of a hot recycled block, one GC page move, one map write-back, or the relocation
+ * of one residual chunk of a low page chosen for reuse.
+ * GC moves and relocations write to the GC stream, so they are done only if gcLogHasRoom: a flush of its log buffer
+ * or a new block could start a whole foreground GC.
+ * The kinds of work are tried round robin, starting after the one served last. */
+#define IdlePrecache        0
+#define IdleGc              1
+#define IdleMapWriteBack    2
+#define IdleRelocation      3
+#if OPTION_ASYNC_RELOCATION
+#define NumIdleTasks        4
+#else
+#define NumIdleTasks        3
+#endif
+
+static UINT32 nextIdleTask = IdlePrecache;
+
+static BOOL8 precachePendingLowPage()
+{
+    for (UINT32 bank=0; bank<NUM_BANKS; bank++)
+    { // only hot blocks are recycled
+#if OPTION_PRECACHE_RING
+        if (isBankBusy(bank) == FALSE && precacheAheadLowPage(bank, hotLogCtrl))
+        {
+            return TRUE;
+        }
+#else
+        if (hotLogCtrl[bank].nextLowPageOffset != INVALID && hotLogCtrl[bank].precacheDone == FALSE && isBankBusy(bank) == FALSE)
+        {
+            precacheLowPage(bank, hotLogCtrl);
+            return TRUE;
+        }
+#endif
+    }
+    return FALSE;
+}
+
+static void idleWorkSlice()
+{
+    for (UINT32 i=0; i<NumIdleTasks; i++)
+    {
+        UINT32 task = (nextIdleTask + i) % NumIdleTasks;
+        BOOL8 done;
+        switch (task)
+        {
+            case IdlePrecache:
+            {
+                done = precachePendingLowPage();
+                break;
+            }
+            case IdleGc:
+            {
+                done = backgroundCleaning(bank_);
+                break;
+            }
+#if OPTION_ASYNC_RELOCATION
+            case IdleRelocation:
+            {
+                done = relocateResidualChunkStep(bank_);
+                break;
+            }
+#endif
+            default:
+            {
+                done = chunksMapWriteBackStep();
+                break;
+            }
+        }
+        if (done)
+        {
+            nextIdleTask = (task + 1) % NumIdleTasks;
+            return;
+        }
+    }
+}
+#else
+#define idleWorkSlice()
+#endif
+
 static void syncWithWriteLimit() {
 #if OPTION_DEBUG_WRITE
     int count=0;
     while(g_ftl_write_buf_id != GETREG(BM_WRITE_LIMIT))
     {
-        backgroundCleaning(bank_);
+        idleWorkSlice();
         count++;
         if (count == 100000) {
             count=0;
@@ -574,7 +875,7 @@ static void syncWithWriteLimit() {
 #else
     while(g_ftl_write_buf_id != GETREG(BM_WRITE_LIMIT))
     {
-        backgroundCleaning(bank_);
+        idleWorkSlice();
     }
 #endif
 }
@@ -586,7 +887,19 @@ void writeToLogBlk (LogCtrlBlock * ctrlBlock, UINT32 const dataLpn, UINT32 const
     uart_print("writeToLogBlk dataLpn="); uart_print_int(dataLpn);
     uart_print(", sect_offset="); uart_print_int(sectOffset);
     uart_print(", num_sectors="); uart_print_int(nSects); uart_print("\r\n");
-    bank_ = chooseNewBank( (dataLpn * CHUNKS_PER_PAGE) + (sectOffset / SECTORS_PER_CHUNK) );
+#if OPTION_COMPRESSED_MAP
+    consolidateFragmentedPages(); // every host chunk write, whatever entry point routed it
+#endif
+#if OPTION_READ_CACHE
+    readCacheInvalidate(dataLpn);
+#endif
+#if OPTION_READ_AHEAD
+    readAheadInvalidate(dataLpn);
+#endif
+#if OPTION_ASYNC_RMW
+    pendingMergePoll();
+#endif
+    bank_ = chooseNewBank(ctrlBlock, sectOffset, nSects);
     initWrite(ctrlBlock, dataLpn, sectOffset, nSects);
     if (nSects_ != SECTORS_PER_PAGE)
     {
@@ -620,7 +933,13 @@ static void writeCompletePage()
     UINT32 logicalAddresses[CHUNKS_PER_PAGE];
     UINT32 oldChunkAddresses[CHUNKS_PER_PAGE];
 
-    mem_copy(oldChunkAddresses, ChunksMapTable(lpn_, 0), CHUNKS_PER_PAGE * sizeof(UINT32));
+    getPageChunkAddrs(lpn_, oldChunkAddresses);
+#if OPTION_SECTOR_OVERLAY
+    for (UINT32 i=0; i<CHUNKS_PER_PAGE; i++)
+    {
+        sectorOverlayDrop(lpn_, i);
+    }
+#endif
 
 
     UINT32 logicalAddress = (bank_ * LOG_BLK_PER_BANK * CHUNKS_PER_BLK) + (newLogLpn * CHUNKS_PER_PAGE);
@@ -648,7 +967,7 @@ static void writeCompletePage()
     }
 
     mem_copy(chunkInLpnsList(ctrlBlock_[bank_].lpnsListAddr, LogPageToOffset(newLogLpn), 0), dataLpns, CHUNKS_PER_PAGE*sizeof(UINT32));
-    mem_copy(ChunksMapTable(lpn_, 0), logicalAddresses, CHUNKS_PER_PAGE*sizeof(UINT32));
+    setPageChunkAddrs(lpn_, logicalAddresses);
 
     ctrlBlock_[bank_].increaseLpn(bank_, ctrlBlock_);
     if (ctrlBlock_[bank_].chunkPtr >= CHUNKS_PER_RECYCLED_PAGE)
@@ -662,12 +981,19 @@ static void writeChunkNew(UINT32 nSectsToWrite)
     uart_print("writeChunkNew\r\n");
     UINT32 src = WR_BUF_PTR(g_ftl_write_buf_id)+(sectOffset_*BYTES_PER_SECTOR);
     UINT32 dst = ctrlBlock_[bank_].logBufferAddr+(ctrlBlock_[bank_].chunkPtr*BYTES_PER_CHUNK); // base address of the destination chunk
-    waitBusyBank(bank_);
-    if (nSectsToWrite != SECTORS_PER_CHUNK)
+    UINT32 startByte = (sectOffset_ % SECTORS_PER_CHUNK) * BYTES_PER_SECTOR;
+    UINT32 endByte = startByte + (nSectsToWrite * BYTES_PER_SECTOR);
+    waitLogBufferFree(bank_);
+    // Only the sectors not written by the host are initialized with 0xFF
+    if (startByte > 0)
     {
-        mem_set_dram (dst, 0xFFFFFFFF, BYTES_PER_CHUNK); // Initialize chunk in dram log buffer with 0xFF
+        mem_set_dram (dst, 0xFFFFFFFF, startByte);
     }
-    mem_copy(dst+((sectOffset_ % SECTORS_PER_CHUNK) * BYTES_PER_SECTOR), src, nSectsToWrite*BYTES_PER_SECTOR);
+    if (endByte < BYTES_PER_CHUNK)
+    {
+        mem_set_dram (dst + endByte, 0xFFFFFFFF, BYTES_PER_CHUNK - endByte);
+    }
+    mem_copy(dst + startByte, src, nSectsToWrite*BYTES_PER_SECTOR);
 }
 
 static void writePartialPageOld()
@@ -699,13 +1025,19 @@ static void writeChunkOld()
     uart_print("writeChunkOld\r\n");
     UINT32 nSectsToWrite = (((sectOffset_ % SECTORS_PER_CHUNK) + remainingSects_) < SECTORS_PER_CHUNK) ? remainingSects_ : (SECTORS_PER_CHUNK - (sectOffset_ % SECTORS_PER_CHUNK));
     UINT32 chunkIdx = sectOffset_ / SECTORS_PER_CHUNK;
-#if OPTION_DEBUG_WRITE
-    if (ChunksMapTable(lpn_, chunkIdx) > DRAM_BASE + DRAM_SIZE)
+    UINT32 oldChunkAddr = getChunkAddr(lpn_, chunkIdx);
+#if OPTION_SECTOR_OVERLAY
+    if (nSectsToWrite == SECTORS_PER_CHUNK)
     {
-        uart_print_level_1("ERROR in writeChunkOld 1: reading above DRAM address space\r\n");
+        sectorOverlayDrop(lpn_, chunkIdx);
+    }
+    else if (sectorOverlayAbsorb(lpn_, chunkIdx, oldChunkAddr, sectOffset_ % SECTORS_PER_CHUNK, nSectsToWrite, WR_BUF_PTR(g_ftl_write_buf_id) + (chunkIdx * BYTES_PER_CHUNK)))
+    {
+        sectOffset_ += nSectsToWrite;
+        remainingSects_ -= nSectsToWrite;
+        return;
     }
 #endif
-    UINT32 oldChunkAddr = read_dram_32(ChunksMapTable(lpn_, chunkIdx));
     uart_print("Old chunk is ");
     switch (findChunkLocation(oldChunkAddr))
     {
@@ -740,6 +1072,9 @@ static void writeChunkOld()
             decrementValidChunks(&heapDataFirstUsage, oldChunkBank, ChunkToLbn(oldChunkAddr));
             decrementValidChunks(&heapDataSecondUsage, oldChunkBank, ChunkToLbn(oldChunkAddr));
             decrementValidChunks(&heapDataCold, oldChunkBank, ChunkToLbn(oldChunkAddr));
+#if OPTION_PAGE_VALID_SUMMARY
+            clearChunkValidSummary(oldChunkAddr);
+#endif
 
 // note(fabio): insert this just to have GC tests working. Probably should disable this checks if they become too heavy
             if (gcState[oldChunkBank] != GcIdle && ChunkToLbn(oldChunkAddr) == victimLbn[oldChunkBank])
@@ -764,14 +1099,16 @@ static void writeChunkOld()
             }
             else
             {
-                writeChunkNew(SECTORS_PER_CHUNK);
-                //writePartialChunkWhenOldChunkIsInFlashLogEncoded(nSectsToWrite, oldChunkAddr);
+                writePartialChunkWhenOldChunkIsInFlashLogEncoded(nSectsToWrite, oldChunkAddr);
             }
             UINT32 realOldChunkAddr = oldChunkAddr & ~(ColdLogBufBitFlag);
             UINT32 oldChunkBank = ChunkToBank(realOldChunkAddr);
             decrementValidChunks(&heapDataFirstUsage, oldChunkBank, ChunkToLbn(realOldChunkAddr));
             decrementValidChunks(&heapDataSecondUsage, oldChunkBank, ChunkToLbn(realOldChunkAddr));
             decrementValidChunks(&heapDataCold, oldChunkBank, ChunkToLbn(realOldChunkAddr));
+#if OPTION_PAGE_VALID_SUMMARY
+            clearChunkValidSummary(realOldChunkAddr);
+#endif
 
 // note(fabio): insert this just to have GC tests working. Probably should disable this checks if they become too heavy
             if (gcState[oldChunkBank] != GcIdle && ChunkToLbn(realOldChunkAddr) == victimLbn[oldChunkBank])
@@ -821,7 +1158,7 @@ static void writeChunkOld()
                 ctrlBlock_[bank_].updateChunkPtr();
             }
 #else
-            writePartialChunkWhenOldIsInDRAMBuf(nSectsToWrite, oldSectOffset, HOT_LOG_BUF(oldBank));
+            writePartialChunkWhenOldIsInDRAMBuf(nSectsToWrite, oldSectOffset, hotLogCtrl[oldBank].logBufferAddr);
 #endif
             sectOffset_ += nSectsToWrite;
             remainingSects_ -= nSectsToWrite;
@@ -840,9 +1177,10 @@ static void writeChunkOld()
             { //note(fabio): Silly strategy that don't overwrites in DRAM and writes to another location
                 UINT32 oldChunkOffset = oldSectOffset / SECTORS_PER_CHUNK;
 
-                coldLogCtrl[oldBank].dataLpn[oldChunkOffset]=INVALID;
-                coldLogCtrl[oldBank].chunkIdx[oldChunkOffset]=INVALID;
-                coldLogCtrl[oldBank].allChunksInLogAreValid = FALSE;
+                LogCtrlBlock * oldCtrlBlock = ColdStreamCtrlOfBufChunk(oldChunkAddr);
+                oldCtrlBlock[oldBank].dataLpn[oldChunkOffset]=INVALID;
+                oldCtrlBlock[oldBank].chunkIdx[oldChunkOffset]=INVALID;
+                oldCtrlBlock[oldBank].allChunksInLogAreValid = FALSE;
                 if (nSectsToWrite == SECTORS_PER_CHUNK)
                 {
                     writeChunkNew(nSectsToWrite);
@@ -865,7 +1203,7 @@ static void writeChunkOld()
                 ctrlBlock_[bank_].updateChunkPtr();
             }
 #else
-            writePartialChunkWhenOldIsInDRAMBuf(nSectsToWrite, oldSectOffset, COLD_LOG_BUF(oldBank));
+            writePartialChunkWhenOldIsInDRAMBuf(nSectsToWrite, oldSectOffset, ColdStreamCtrlOfBufChunk(oldChunkAddr)[oldBank].logBufferAddr);
 #endif
             sectOffset_ += nSectsToWrite;
             remainingSects_ -= nSectsToWrite;
@@ -884,6 +1222,9 @@ static void writePartialChunkWhenOldIsInDRAMBuf(UINT32 nSectsToWrite, UINT32 old
     // Sizes
     UINT32 startOffsetWrite = (sectOffset_ % SECTORS_PER_CHUNK) * BYTES_PER_SECTOR;
 
+#if OPTION_ASYNC_RMW
+    pendingMergeComplete(dstWBufStart, BYTES_PER_CHUNK);
+#endif
     mem_copy(dstWBufStart+startOffsetWrite, srcSataBufStart+startOffsetWrite, nSectsToWrite*BYTES_PER_SECTOR);
     #if MeasureDramAbsorb
     uart_print_level_1("WRDRAM "); uart_print_level_1_int(nSectsToWrite); uart_print_level_1("\r\n");
@@ -906,13 +1247,39 @@ static void writePartialChunkWhenOldChunkIsInFlashLog(UINT32 nSectsToWrite, UINT
     UINT32 dstByteOffset = ctrlBlock_[bank_].chunkPtr * BYTES_PER_CHUNK;
     UINT32 srcByteOffset = ChunkToChunkOffset(oldChunkAddr) * BYTES_PER_CHUNK;
     UINT32 alignedWBufAddr = ctrlBlock_[bank_].logBufferAddr + dstByteOffset - srcByteOffset;
-    waitBusyBank(bank_);
+    waitLogBufferFree(bank_);
+#if OPTION_ASYNC_RMW
+    // The host sectors are merged when the read is done, see pendingMerge.c
+    nand_page_ptread(oldBank, oldVbn, oldPageOffset, oldSectOffset, SECTORS_PER_CHUNK, alignedWBufAddr, RETURN_ON_ISSUE);
+    pendingMergeAdd(dstWBufChunkStart, src, startOffsetWrite, nSectsToWrite*BYTES_PER_SECTOR, oldBank);
+#else
     nand_page_ptread(oldBank, oldVbn, oldPageOffset, oldSectOffset, SECTORS_PER_CHUNK, alignedWBufAddr, RETURN_WHEN_DONE);
     mem_copy(dstWBufChunkStart + startOffsetWrite, src + startOffsetWrite, nSectsToWrite*BYTES_PER_SECTOR);
+#endif
 }
 
 static void writePartialChunkWhenOldChunkIsInFlashLogEncoded(UINT32 nSectsToWrite, UINT32 oldChunkAddr)
 {
-    uart_print_level_1("writePartialChunkWhenOldChunkIsInFlashLogEncoded is not implemented yet!\r\n");
-    while(1);
+    uart_print("writePartialChunkWhenOldChunkIsInFlashLogEncoded\r\n");
+    UINT32 src = WR_BUF_PTR(g_ftl_write_buf_id)+((sectOffset_ / SECTORS_PER_CHUNK)*BYTES_PER_CHUNK);
+    UINT32 dstWBufChunkStart = ctrlBlock_[bank_].logBufferAddr + (ctrlBlock_[bank_].chunkPtr * BYTES_PER_CHUNK); // base address of the destination chunk
+    UINT32 startOffsetWrite = (sectOffset_ % SECTORS_PER_CHUNK) * BYTES_PER_SECTOR;
+    UINT32 realOldChunkAddr = oldChunkAddr & ~(ColdLogBufBitFlag);
+    waitLogBufferFree(bank_);
+#if OPTION_ASYNC_RMW
+    pendingMergeAddEncoded(dstWBufChunkStart, src, startOffsetWrite, nSectsToWrite*BYTES_PER_SECTOR, realOldChunkAddr);
+#else
+    UINT32 oldBank = ChunkToBank(realOldChunkAddr);
+    UINT32 srcByteOffset = ChunkToSectOffset(realOldChunkAddr) * BYTES_PER_SECTOR;
+    nand_page_ptread(oldBank,
+                     get_log_vbn(oldBank, ChunkToLbn(realOldChunkAddr)),
+                     ChunkToPageOffset(realOldChunkAddr),
+                     srcByteOffset / BYTES_PER_SECTOR,
+                     SECTORS_PER_ENCODED_CHUNK,
+                     TEMP_BUF_ADDR - srcByteOffset, // buf addr + dst - src
+                     RETURN_WHEN_DONE);
+    // Decode TEMP_BUF_ADDR into the log buffer!!!
+    mem_copy(dstWBufChunkStart, TEMP_BUF_ADDR, BYTES_PER_CHUNK);
+    mem_copy(dstWBufChunkStart + startOffsetWrite, src + startOffsetWrite, nSectsToWrite*BYTES_PER_SECTOR);
+#endif
 }
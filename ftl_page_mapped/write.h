@@ -12,9 +12,13 @@ void writeToLogBlk (LogCtrlBlock * ctrlBlock,
                     UINT32 const sectOffset,
                     UINT32 const nSects);
 
+void writeMergedChunk(const UINT32 bank, const UINT32 dataLpn, const UINT32 chunkIdx, const UINT32 srcChunkAddr);
+BOOL8 gcLogHasRoom(const UINT32 bank, const UINT32 nChunks);
+
 void updateChunkPtr();
 void updateChunkPtrRecycledPage();
+BOOL8 flushPartialLogBuffer(LogCtrlBlock * ctrlBlock, const UINT32 bank);
 
-UINT32 chooseNewBank(UINT32 lpn);
+UINT32 chooseNewBank(LogCtrlBlock * ctrlBlock, const UINT32 sectOffset, const UINT32 nSects);
 
 #endif
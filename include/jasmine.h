@@ -65,6 +65,27 @@
 #define OPTION_SUPPORT_NCQ              0    // 1 = support SATA NCQ (=FPDMA) for AHCI hosts, 0 = support only DMA mode
 #define OPTION_REDUCED_CAPACITY         0    // reduce the number of blocks per bank for testing purpose
 #define OPTION_SUPPORT_TRIM             1   // 1 = enables trim support for FTLs that support it.
+#define OPTION_READ_CACHE               1   // 1 = keep recently read logical pages in a DRAM read cache, 0 = disable
+#define OPTION_READ_AHEAD               1   // 1 = prefetch sequential read streams on idle banks when the host enables read look-ahead, 0 = disable
+#define OPTION_READ_PREEMPT_GC          1   // 1 = host reads waiting in the event queue are served between GC page moves, 0 = disable
+#define OPTION_DEMAND_PAGED_MAP         0   // 1 = chunks map table kept in map blocks and cached in DRAM on demand, 0 = whole table resident in DRAM
+#define OPTION_COMPRESSED_MAP           0   // 1 = one map entry per lpn for pages written contiguously, chunk entries only for the others, 0 = chunk entries for all lpns
+#define OPTION_MAP_ENTRY_CACHE          1   // 1 = cache the map entries of recently used lpns in SRAM, 0 = every map access goes to DRAM
+#define OPTION_CHANNEL_FIRST_STRIPING   1   // 1 = consecutive writes walk the channels first and then the ways, 0 = the ways of a channel first
+#define OPTION_SYNC_IDLE_WORK           1   // 1 = precaching, pending GC steps and map write-back are advanced while waiting for host data, 0 = busy wait
+#define OPTION_DOUBLE_LOG_BUFFERS       1   // 1 = two log buffers per bank and log, chunks are copied into one while the other is programmed, 0 = one log buffer
+#define OPTION_ASYNC_RMW                1   // 1 = partial chunk overwrites do not wait for the read of the old chunk, 0 = synchronous read-modify-write
+#define OPTION_SECTOR_OVERLAY           1   // 1 = sub-chunk writes to chunks in flash are kept in a sector-granular overlay merged later, 0 = read-modify-write at once
+#define OPTION_TEMPERATURE_DETECTOR     1   // 1 = ftl_write routes every chunk to the hot or cold log by its update frequency, 0 = by request size and lba thresholds
+#define OPTION_LOG_STREAMS              1   // 1 = GC relocations are written to extra cold log streams chosen by GC age, 0 = GC shares the cold log with host writes
+#define OPTION_HOST_HINTS               1   // 1 = the host can tag lba ranges as hot or cold with a vendor-specific command, 0 = the command is rejected
+#define OPTION_FIXED_POINT_REUSE        1   // 1 = the hot reuse threshold follows an integer proportional controller, 0 = float window average and fixed steps
+#define OPTION_PAGE_VALID_SUMMARY       1   // 1 = a bitmap of the valid chunks of every log page rejects low pages that cannot be reused without searching the map, 0 = map search only
+#define OPTION_ASYNC_RELOCATION         1   // 1 = the residual valid chunks of a reused low page are relocated in the background, 0 = synchronously in canReuseLowPage
+#define OPTION_PRECACHE_RING            1   // 1 = the next reusable low pages of a recycled hot block are read ahead into a ring of encode buffers, 0 = only the next one
+#define OPTION_COLD_REUSE               1   // 1 = cold streams reuse the high pages of first usage hot blocks with few valid low chunks, with their own controller, 0 = as set by CanReuseBlksForColdData
+#define OPTION_CLEAN_LIST_RING          1   // 1 = clean blocks are tracked by an SRAM bitmap and a per-bank ring of lbns, 0 = DRAM linked lists
+#define OPTION_WEAR_AWARE_CLEAN_LIST    0   // 1 = cleanListPop returns the least erased clean block instead of the oldest one, needs OPTION_CLEAN_LIST_RING
 
 #define CHN_WIDTH           2     // 2 = 16bit IO
 #define NUM_CHNLS_MAX       4
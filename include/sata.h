@@ -93,9 +93,14 @@ typedef struct
 	BOOL8	write_cache_enabled;
 
 	BOOL8	read_look_ahead_enabled;
-	UINT8	unused1;
+	volatile BOOL8	fua_write_pending;	// the status of the FUA write fua_write_seq is sent only once its data is on flash
 	UINT8	unused2;
 	UINT8	unused3;
+	volatile UINT32	eq_writes_inserted;	// write commands inserted in the event queue by the ISR
+	UINT32	eq_writes_done;	// write commands completed by Main, in event queue order
+	volatile UINT32	fua_write_seq;	// value of eq_writes_inserted for the FUA write
+	CMD_T	deferred_cmd;	// command taken out of the event queue by sata_serve_pending_reads that could not be served there
+	BOOL8	deferred_cmd_pending;	// cleared by sata_reset together with the event queue
 } sata_context_t;
 
 extern sata_context_t	g_sata_context;
@@ -149,6 +154,7 @@ enum
 	ATA_WRITE_DMA_EXT				= 0x35,	/* Write DMA Ext 			 */
 	ATA_SET_MAX_ADDRESS_EXT			= 0x37,	/* Set Max Address Ext 		 */
 	ATA_WRITE_MULTIPLE_EXT			= 0x39,	/* Write Multiple Ext		 */
+	ATA_WRITE_DMA_FUA_EXT			= 0x3D,	/* Write DMA FUA Ext		 */
 	ATA_WRITE_LOG_EXT				= 0x3F,	/* Write Log Ext			 */
 	ATA_READ_VERIFY_SECTORS			= 0x40, /* Read Verify Sectors		 */
 	ATA_READ_VERIFY_SECTORS_EXT		= 0x42, /* Read Verify Sectors Ext	 */
@@ -184,6 +190,7 @@ enum
 	ATA_SECURITY_DISABLE_PASSWORD	= 0xF6, /* Security Disable Password */
 	ATA_READ_NATIVE_MAX_ADDRESS		= 0xF8,	/* Read Native Max Address   */
 	ATA_SET_MAX_ADDRESS				= 0xF9,	/* Set Max Address   		 */
+	ATA_SET_HOST_HINT				= 0xFA,	/* Set Host Hint (vendor specific) */
 	ATA_SRST						= 0xFF	/* SRST request is regarded as if it were an ATA command. */
 };
 
@@ -230,6 +237,7 @@ enum
 void send_status_to_host(UINT32 const err_code);
 void sata_reset(void);
 void pio_sector_transfer(UINT32 const dram_addr, UINT32 const protocol);
+UINT32 sata_serve_pending_reads(UINT32 const max_reads);
 
 extern volatile UINT32 g_sata_action_flags;
 
@@ -20,7 +20,7 @@
 #ifndef SATA_CMD_H
 #define SATA_CMD_H
 
-#define	ATA_CMD_NUM			59
+#define	ATA_CMD_NUM			60
 #define	CMD_TABLE_SIZE		60
 
 
@@ -76,6 +76,7 @@ void ata_initialize_device_parameters(UINT32 lba, UINT32 sector_count);
 void ata_not_supported(UINT32 lba, UINT32 sector_count);
 void ata_srst(UINT32 lba, UINT32 sector_count);
 void ata_dsm(UINT32 lba, UINT32 sector_count);
+void ata_set_host_hint(UINT32 lba, UINT32 sector_count);
 
 
 #endif	// SATA_CMD_H
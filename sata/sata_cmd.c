@@ -18,6 +18,7 @@
 
 
 #include "jasmine.h"
+#include "hostHints.h"
 
 
 void ata_check_power_mode(UINT32 lba, UINT32 sector_count)
@@ -74,6 +75,7 @@ void ata_set_features(UINT32 lba, UINT32 sector_count)
 			break;
 		case FEATURE_DISABLE_WRITE_CACHE:
 			g_sata_context.write_cache_enabled = FALSE;
+			ftl_flush();
 			break;
 		case FEATURE_DISABLE_USE_OF_SATA:
 			if ((sector_count & 0xFF) == 0x02)
@@ -361,3 +363,16 @@ void ata_dsm(UINT32 lba, UINT32 sector_count)
 	ftl_trim(lba, sector_count);
 	send_status_to_host(0);
 }
+
+// Vendor specific: the features register carries the hint (see hostHints.h) for the lba range.
+void ata_set_host_hint(UINT32 lba, UINT32 sector_count)
+{
+#if OPTION_HOST_HINTS
+	if (hostHintsSet(lba, sector_count, GETREG(SATA_FIS_H2D_0) >> 24))
+	{
+		send_status_to_host(0);
+		return;
+	}
+#endif
+	send_status_to_host(B_ABRT);
+}
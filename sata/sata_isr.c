@@ -176,8 +176,17 @@ static __inline void handle_got_cfis(void)
 
             if (cmd_type & CCL_FTL_H2D) {
                 SETREG(SATA_INSERT_EQ_W, 1);	// The contents of SATA_LBA and SATA_SECT_CNT are inserted into the event queue as a write command.
-                if (cmd_code == ATA_WRITE_DMA || cmd_code == ATA_WRITE_DMA_EXT) {
-                    action_flags = DMA_WRITE | COMPLETE;
+                g_sata_context.eq_writes_inserted++;
+                if (cmd_code == ATA_WRITE_DMA || cmd_code == ATA_WRITE_DMA_EXT || cmd_code == ATA_WRITE_DMA_FUA_EXT) {
+                    if (cmd_code == ATA_WRITE_DMA_FUA_EXT || g_sata_context.write_cache_enabled == FALSE) {
+                        // no automatic status: Main sends it after the ftl_write of this command and ftl_flush,
+                        // earlier writes may still be in the event queue
+                        g_sata_context.fua_write_seq = g_sata_context.eq_writes_inserted;
+                        g_sata_context.fua_write_pending = TRUE;
+                        action_flags = DMA_WRITE;
+                    } else {
+                        action_flags = DMA_WRITE | COMPLETE;
+                    }
                 } else {
                     UINT32 fis_type = FISTYPE_PIO_SETUP;
                     UINT32 flags = B_IRQ;
@@ -224,6 +233,7 @@ static __inline void handle_got_cfis(void)
                 SETREG(SATA_LBA, 0x3FFFFFFF);
                 SETREG(SATA_SECT_CNT, sector_count);
                 SETREG(SATA_INSERT_EQ_W, 1);	// The contents of SATA_LBA and SATA_SECT_CNT are inserted into the event queue as a write command.
+                g_sata_context.eq_writes_inserted++;
                 SETREG(SATA_XFER_BYTES, sector_count * BYTES_PER_SECTOR);
                 SETREG(SATA_SECT_OFFSET, 0); // Fabio: Maybe in this way the ranges list will start at the beginning of the buffer
                 SETREG(SATA_CTRL_2, DMA_WRITE | COMPLETE);
@@ -19,6 +19,7 @@
 
 #include "jasmine.h"
 #include "garbage_collection.h"
+#include "hostHints.h"
 
 //#define uart_print(x)
 //#define uart_print_int(x)
@@ -92,6 +93,31 @@ ATA_FUNCTION_T search_ata_function(UINT32 command_code)
     return ata_function;
 }
 
+// Called by the FTL at its preemption points (e.g. between GC page moves).
+// Serves up to max_reads host reads waiting in the event queue and returns how many were served.
+// The first command that is not a read, or a read overlapping a write still in progress, is parked
+// in g_sata_context.deferred_cmd and served by the main loop, so that the order of the queue is preserved.
+UINT32 sata_serve_pending_reads(UINT32 const max_reads)
+{
+    UINT32 served = 0;
+    while (served < max_reads && g_sata_context.deferred_cmd_pending == FALSE && eventq_get_count())
+    {
+        CMD_T cmd;
+        eventq_get(&cmd);
+        if (cmd.cmd_type == READ && ftl_read_can_preempt(cmd.lba, cmd.sector_count))
+        {
+            ftl_read(cmd.lba, cmd.sector_count);
+            served++;
+        }
+        else
+        {
+            g_sata_context.deferred_cmd = cmd;
+            g_sata_context.deferred_cmd_pending = TRUE;
+        }
+    }
+    return served;
+}
+
 //UINT32 bankForBGCleaning=0;
 
 void Main(void)
@@ -99,11 +125,19 @@ void Main(void)
     //int count = 0;
     while (1)
     {
-        if (eventq_get_count())
+        if (g_sata_context.deferred_cmd_pending || eventq_get_count())
         {
             //count = 0;
             CMD_T cmd;
-            eventq_get(&cmd);
+            if (g_sata_context.deferred_cmd_pending)
+            {
+                cmd = g_sata_context.deferred_cmd;
+                g_sata_context.deferred_cmd_pending = FALSE;
+            }
+            else
+            {
+                eventq_get(&cmd);
+            }
             if (cmd.cmd_type == READ)
             {
                 ftl_read(cmd.lba, cmd.sector_count);
@@ -118,7 +152,30 @@ void Main(void)
                     }
                     else
                     {
+#if OPTION_HOST_HINTS
+                        // the hint of the range holding the first sector applies to the whole request
+                        switch (hostHintOf(cmd.lba))
+                        {
+                            case HostHintHot:
+                                ftl_write_hot(cmd.lba, cmd.sector_count);
+                                break;
+                            case HostHintCold:
+                                ftl_write_cold(cmd.lba, cmd.sector_count);
+                                break;
+                            default:
+                                ftl_write(cmd.lba, cmd.sector_count);
+                                break;
+                        }
+#else
                         ftl_write(cmd.lba, cmd.sector_count);
+#endif
+                    }
+                    g_sata_context.eq_writes_done++;
+                    if (g_sata_context.fua_write_pending && g_sata_context.eq_writes_done == g_sata_context.fua_write_seq)
+                    { // this was the FUA write: without NCQ the host waits for this status before sending another command
+                        ftl_flush();
+                        g_sata_context.fua_write_pending = FALSE;
+                        send_status_to_host(0);
                     }
                 }
                 else
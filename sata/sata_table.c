@@ -84,7 +84,7 @@ ATR_NO_SECT|ATR_LBA_EXT	| 	CCL_OTHER,			// 0x37	Set Max Address Ext
 							CCL_UNDEFINED,		// 0x3A
 							CCL_UNDEFINED,		// 0x3B
 							CCL_UNDEFINED,		// 0x3C
-							CCL_UNDEFINED,		// 0x3D
+			ATR_LBA_EXT |	CCL_FTL_H2D,		// 0x3D	Write DMA FUA Ext
 							CCL_UNDEFINED,		// 0x3E
 			ATR_LBA_EXT	| 	CCL_OTHER,			// 0x3F	Write Log Ext
 			ATR_LBA_NOR	| 	CCL_OTHER,			// 0x40	Read Verify Sectors
@@ -273,7 +273,7 @@ ATR_NO_SECT|ATR_LBA_EXT	| 	CCL_OTHER,			// 0x37	Set Max Address Ext
 							CCL_UNDEFINED,		// 0xF7
 			ATR_LOCK_FREE |	CCL_OTHER,			// 0xF8	Read Native Max Address
 ATR_NO_SECT|ATR_LBA_NOR	| 	CCL_OTHER,			// 0xF9	Set Max Address
-							CCL_UNDEFINED,		// 0xFA
+			ATR_LBA_EXT	|	CCL_OTHER,			// 0xFA Set Host Hint (vendor specific)
 							CCL_UNDEFINED,		// 0xFB
 			ATR_LBA_NOR |	CCL_OTHER,			// 0xFC Delete
 			ATR_LBA_EXT	|	CCL_OTHER,			// 0xFD Delete Ext
@@ -343,7 +343,7 @@ const UINT8 ata_command_code_table[] =
     0xFC,  // 56 DELETE
     0xFD,  // 57 DELETE EXT
     0xFF,   // 58 SRST
-    0xFF,   // 59 Dummy for 4 byte alignment
+    0xFA,   // 59 SET HOST HINT (vendor specific)
 };
 
 const ATA_FUNCTION_T ata_function_table[] =
@@ -407,5 +407,6 @@ const ATA_FUNCTION_T ata_function_table[] =
 	(ATA_FUNCTION_T) INVALID32,
 	(ATA_FUNCTION_T) INVALID32,
 	ata_srst,							// SRST
+	ata_set_host_hint,					// SET HOST HINT
 };
 